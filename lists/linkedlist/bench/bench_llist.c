@@ -0,0 +1,448 @@
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../headers/llist.h"
+
+/*---------------------------------------*/
+/* Latency histogram                     */
+/*---------------------------------------*/
+/* Values below 2^LAT_SUB_BITS are exact; above that each
+** power of two is split into 2^LAT_SUB_BITS sub-buckets,
+** which bounds the relative error to ~6%. */
+#define LAT_SUB_BITS 4
+#define LAT_SUB      (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS  ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef struct
+{
+  uint64_t buckets[LAT_BUCKETS];
+  uint64_t count;
+} lat_hist_t;
+
+/*---------------------------------------*/
+/* Typedefs                              */
+/*---------------------------------------*/
+typedef enum { DIST_UNIFORM, DIST_ZIPF } dist_type_t;
+typedef enum { INGEST_OFF, INGEST_SORTED, INGEST_NEARLY, INGEST_RANDOM } ingest_type_t;
+
+typedef struct
+{
+  int threads;
+  int key_range;
+  int read_pct;
+  double seconds;
+  double theta;
+  dist_type_t dist;
+  ingest_type_t ingest;
+  llorder_type_t order;
+  unsigned int flags;
+  int header;
+} bench_cfg_t;
+
+typedef struct
+{
+  double alpha;
+  double zetan;
+  double eta;
+  double theta;
+  int n;
+} zipf_t;
+
+typedef struct
+{
+  pthread_t thread;
+  uint64_t seed;
+  uint64_t ops;
+  lat_hist_t lat;
+  int * window;
+} bench_worker_t;
+
+/*---------------------------------------*/
+/* Globals                               */
+/*---------------------------------------*/
+static llist_t * llist;
+static bench_cfg_t cfg;
+static zipf_t zipf;
+static volatile int stop;
+static uint64_t ingest_seq;
+
+/*---------------------------------------*/
+/* Helper Functions                      */
+/*---------------------------------------*/
+static uint64_t
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+bench_rand(uint64_t * state)
+/* xorshift64* */
+{
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static double
+bench_rand_unit(uint64_t * state)
+{
+  return (bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void
+zipf_init(zipf_t * z, int n, double theta)
+/* Zipfian generator from Gray et al., "Quickly Generating
+** Billion-Record Synthetic Databases", as used by YCSB.
+**/
+{
+  double zeta2 = 1.0 + pow(0.5, theta);
+  int i;
+
+  z->n = n;
+  z->theta = theta;
+  z->zetan = 0;
+  for (i = 1; i <= n; i++)
+    z->zetan += 1.0 / pow((double)i, theta);
+  z->alpha = 1.0 / (1.0 - theta);
+  z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+static int
+zipf_next(zipf_t * z, uint64_t * state)
+{
+  double u = bench_rand_unit(state);
+  double uz = u * z->zetan;
+  int rank;
+
+  if (uz < 1.0)
+    rank = 0;
+  else if (uz < 1.0 + pow(0.5, z->theta))
+    rank = 1;
+  else
+    rank = (int)(z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+
+  if (rank >= z->n)
+    rank = z->n - 1;
+
+  /* Scatters hot ranks over the key range so they are
+     not all clustered at the head of ordered lists */
+  return (int)(((uint64_t)rank * 2654435761ull) % (uint64_t)z->n);
+}
+
+static int
+bench_next_key(uint64_t * state)
+{
+  if (cfg.dist == DIST_ZIPF)
+    return zipf_next(&zipf, state);
+  return (int)(bench_rand(state) % (uint64_t)cfg.key_range);
+}
+
+static void
+lat_record(lat_hist_t * hist, uint64_t v)
+{
+  int idx;
+  if (v < LAT_SUB)
+    idx = (int)v;
+  else
+  {
+    int k = 63 - __builtin_clzll(v);
+    idx = (k - LAT_SUB_BITS + 1) * LAT_SUB
+          + (int)((v >> (k - LAT_SUB_BITS)) & (LAT_SUB - 1));
+  }
+  hist->buckets[idx]++;
+  hist->count++;
+}
+
+static uint64_t
+lat_percentile(lat_hist_t const * hist, double p)
+{
+  uint64_t rank = (uint64_t)ceil(p * (double)hist->count);
+  uint64_t seen = 0;
+  int idx;
+
+  if (hist->count == 0)
+    return 0;
+
+  for (idx = 0; idx < LAT_BUCKETS; idx++)
+  {
+    seen += hist->buckets[idx];
+    if (seen >= rank)
+      break;
+  }
+
+  if (idx < LAT_SUB)
+    return (uint64_t)idx;
+  {
+    int k = idx / LAT_SUB + LAT_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(idx % LAT_SUB);
+    return (LAT_SUB + sub) << (k - LAT_SUB_BITS);
+  }
+}
+
+static void *
+bench_worker(void * arg)
+{
+  bench_worker_t * w = (bench_worker_t *)arg;
+  int write_toggle = 0;
+
+  while (!stop)
+  {
+    int key = bench_next_key(&w->seed);
+    int is_read = (int)(bench_rand(&w->seed) % 100) < cfg.read_pct;
+    uint64_t start = bench_now();
+
+    if (is_read)
+      llist_get(llist, key);
+    else if ((write_toggle ^= 1))
+      llist_insert(llist, llnode_create(key));
+    else
+      llist_delete(llist, key);
+
+    lat_record(&w->lat, bench_now() - start);
+    w->ops++;
+  }
+  return NULL;
+}
+
+static int
+bench_next_ingest_key(uint64_t * state)
+/* Sorted input follows a shared sequence. Nearly sorted
+** input delays one in eight keys by up to 64 positions.
+**/
+{
+  uint64_t seq = __atomic_fetch_add(&ingest_seq, 1, __ATOMIC_RELAXED);
+
+  if (cfg.ingest == INGEST_RANDOM)
+    return (int)(bench_rand(state) & 0x7FFFFFFF);
+
+  if (cfg.ingest == INGEST_NEARLY
+      && bench_rand(state) % 8 == 0)
+    seq -= bench_rand(state) % 64;
+
+  return (int)(seq & 0x7FFFFFFF);
+}
+
+static void *
+bench_ingest_worker(void * arg)
+/* Inserts keys in the configured input pattern. Each
+** worker keeps its last key_range / threads keys and
+** deletes the oldest one once full, so the list stays at
+** about key_range elements. Only inserts are timed.
+**/
+{
+  bench_worker_t * w = (bench_worker_t *)arg;
+  int window_sz = cfg.key_range / cfg.threads;
+  uint64_t inserted = 0;
+
+  if (window_sz < 1)
+    window_sz = 1;
+
+  while (!stop)
+  {
+    int key = bench_next_ingest_key(&w->seed);
+    int slot = (int)(inserted % (uint64_t)window_sz);
+    uint64_t start;
+
+    if (inserted >= (uint64_t)window_sz)
+      llist_delete(llist, w->window[slot]);
+    w->window[slot] = key;
+
+    start = bench_now();
+    llist_insert(llist, llnode_create(key));
+    lat_record(&w->lat, bench_now() - start);
+    inserted++;
+    w->ops++;
+  }
+  return NULL;
+}
+
+static char const *
+bench_workload_name(void)
+{
+  switch (cfg.ingest)
+  {
+    case INGEST_SORTED: return "ingest-sorted";
+    case INGEST_NEARLY: return "ingest-nearly";
+    case INGEST_RANDOM: return "ingest-random";
+    default: break;
+  }
+  return cfg.dist == DIST_ZIPF ? "zipf" : "uniform";
+}
+
+static void
+bench_usage(char const * prog)
+{
+  fprintf(stderr,
+          "usage: %s [-t threads] [-k key_range] [-r read_pct]\n"
+          "          [-d uniform|zipf] [-z theta] [-s seconds]\n"
+          "          [-o asc|desc|none] [-i sorted|nearly|random]\n"
+          "          [-a] [-H]\n"
+          "  -i  insert-only ingest of keys in the given pattern\n"
+          "  -a  use an adaptive lock (LLIST_ADAPTIVE_LOCK)\n"
+          "  -H  omit the CSV header\n", prog);
+}
+
+static int
+bench_parse(int argc, char * argv[])
+{
+  int opt;
+
+  cfg.threads = 4;
+  cfg.key_range = 1024;
+  cfg.read_pct = 90;
+  cfg.seconds = 2.0;
+  cfg.theta = 0.99;
+  cfg.dist = DIST_UNIFORM;
+  cfg.ingest = INGEST_OFF;
+  cfg.order = ASC;
+  cfg.flags = LLIST_DEFAULT;
+  cfg.header = 1;
+
+  while ((opt = getopt(argc, argv, "t:k:r:d:z:s:o:i:aH")) != -1)
+  {
+    switch (opt)
+    {
+      case 't': cfg.threads = atoi(optarg); break;
+      case 'k': cfg.key_range = atoi(optarg); break;
+      case 'r': cfg.read_pct = atoi(optarg); break;
+      case 'z': cfg.theta = atof(optarg); break;
+      case 's': cfg.seconds = atof(optarg); break;
+      case 'a': cfg.flags |= LLIST_ADAPTIVE_LOCK; break;
+      case 'H': cfg.header = 0; break;
+      case 'd':
+        if (strcmp(optarg, "zipf") == 0)
+          cfg.dist = DIST_ZIPF;
+        else if (strcmp(optarg, "uniform") == 0)
+          cfg.dist = DIST_UNIFORM;
+        else
+          return -1;
+        break;
+      case 'i':
+        if (strcmp(optarg, "sorted") == 0)
+          cfg.ingest = INGEST_SORTED;
+        else if (strcmp(optarg, "nearly") == 0)
+          cfg.ingest = INGEST_NEARLY;
+        else if (strcmp(optarg, "random") == 0)
+          cfg.ingest = INGEST_RANDOM;
+        else
+          return -1;
+        break;
+      case 'o':
+        if (strcmp(optarg, "asc") == 0)
+          cfg.order = ASC;
+        else if (strcmp(optarg, "desc") == 0)
+          cfg.order = DESC;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.order = NONE;
+        else
+          return -1;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  if (cfg.threads < 1
+      || cfg.key_range < 2
+      || cfg.read_pct < 0 || cfg.read_pct > 100
+      || cfg.seconds <= 0
+      || cfg.theta <= 0 || cfg.theta >= 1)
+    return -1;
+  return 0;
+}
+
+/*---------------------------------------*/
+/* Driver                                */
+/*---------------------------------------*/
+int
+main(int argc, char * argv[])
+{
+  bench_worker_t * workers;
+  lat_hist_t * total;
+  uint64_t ops = 0;
+  uint64_t start, elapsed;
+  int i, j;
+
+  if (bench_parse(argc, argv) != 0)
+  {
+    bench_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (cfg.dist == DIST_ZIPF)
+    zipf_init(&zipf, cfg.key_range, cfg.theta);
+
+  /* Prefills every other key so that inserts and deletes
+     keep the list at about half the key range. Ingest
+     runs start empty */
+  llist = llist_create_with_flags(cfg.order, cfg.flags);
+  if (cfg.ingest == INGEST_OFF)
+    for (i = 0; i < cfg.key_range; i += 2)
+      llist_insert(llist, llnode_create(i));
+
+  workers = (bench_worker_t *) calloc(cfg.threads, sizeof(bench_worker_t));
+  total = (lat_hist_t *) calloc(1, sizeof(lat_hist_t));
+  if (workers == NULL || total == NULL)
+    return EXIT_FAILURE;
+
+  start = bench_now();
+  for (i = 0; i < cfg.threads; i++)
+  {
+    workers[i].seed = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+    if (cfg.ingest != INGEST_OFF)
+    {
+      workers[i].window = (int *) malloc(sizeof(int) * (cfg.key_range / cfg.threads + 1));
+      if (workers[i].window == NULL)
+        return EXIT_FAILURE;
+      pthread_create(&workers[i].thread, NULL, bench_ingest_worker, &workers[i]);
+    }
+    else
+      pthread_create(&workers[i].thread, NULL, bench_worker, &workers[i]);
+  }
+
+  usleep((useconds_t)(cfg.seconds * 1e6));
+  stop = 1;
+
+  for (i = 0; i < cfg.threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    ops += workers[i].ops;
+    for (j = 0; j < LAT_BUCKETS; j++)
+      total->buckets[j] += workers[i].lat.buckets[j];
+    total->count += workers[i].lat.count;
+    free(workers[i].window);
+  }
+  elapsed = bench_now() - start;
+
+  if (cfg.header)
+    puts("structure,threads,key_range,read_pct,dist,seconds,"
+         "ops,ops_per_sec,p50_ns,p99_ns,p999_ns");
+
+  printf("llist%s,%d,%d,%d,%s,%.2f,%llu,%.0f,%llu,%llu,%llu\n",
+         (cfg.flags & LLIST_ADAPTIVE_LOCK) ? "-adaptive" : "",
+         cfg.threads, cfg.key_range,
+         cfg.ingest != INGEST_OFF ? 0 : cfg.read_pct,
+         bench_workload_name(),
+         elapsed / 1e9,
+         (unsigned long long)ops,
+         ops / (elapsed / 1e9),
+         (unsigned long long)lat_percentile(total, 0.50),
+         (unsigned long long)lat_percentile(total, 0.99),
+         (unsigned long long)lat_percentile(total, 0.999));
+
+  llist_free(llist);
+  free(workers);
+  free(total);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+#ifndef ADLOCK_H
+#define ADLOCK_H
+
+#include <stdint.h>
+
+/* Number of backoff rounds a waiter spins through
+** before parking. Round i spins for 2^i pauses. */
+#define ADLOCK_DEFAULT_SPIN_ROUNDS 10
+
+typedef struct adlock_t adlock_t;
+typedef struct adlock_stats_t adlock_stats_t;
+
+struct adlock_stats_t
+{
+  uint64_t acquires;      /* Successful acquisitions       */
+  uint64_t contended;     /* Acquisitions that had to wait */
+  uint64_t spins;         /* Backoff rounds spent spinning */
+  uint64_t parks;         /* Times a waiter was parked     */
+};
+
+struct adlock_t
+{
+  int state;              /* 0: free, 1: held, 2: held with waiters */
+  unsigned int spin_rounds;
+  adlock_stats_t stats;
+};
+
+void adlock_init(adlock_t * lock, unsigned int spin_rounds);
+void adlock_acquire(adlock_t * lock);
+void adlock_release(adlock_t * lock);
+void adlock_get_stats(adlock_t * lock, adlock_stats_t * stats);
+
+#endif /* ADLOCK_H */
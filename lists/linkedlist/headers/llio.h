@@ -0,0 +1,11 @@
+#ifndef LLIO_H
+#define LLIO_H
+
+#include <stddef.h>
+
+/* File helpers shared by the list sources. Private to the
+** library: only src/ includes this header. */
+
+int llio_write_all(int fd, void const * buf, size_t len);
+
+#endif /* LLIO_H */
@@ -1,24 +1,65 @@
 #ifndef LLIST_H
 #define LLIST_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
+#include "./adlock.h"
+#include "./llstats.h"
+
 typedef struct llist_t llist_t;
 typedef struct llnode_t llnode_t;
 typedef enum { ASC, DESC, NONE } llorder_type_t;
 
+/* Creation flags, may be or'ed together */
+typedef enum
+{
+  LLIST_DEFAULT       = 0,
+  LLIST_ADAPTIVE_LOCK = 1 << 0, /* Per-list spin-then-park lock */
+  LLIST_DOUBLY_LINKED = 1 << 1, /* O(1) ASC <-> DESC flips      */
+  LLIST_LAZY_SORT     = 1 << 2, /* Sort on first ordered read   */
+  LLIST_UNIQUE        = 1 << 3  /* Inserts, concats skip dups   */
+} llflag_type_t;
+
+/* Whether set operations copy values into the result or
+** move llnodes out of their inputs */
+typedef enum { LLIST_SET_COPY, LLIST_SET_MOVE } llset_mode_t;
+
+/* Output formats of llist_dump */
+typedef enum { LLIST_DUMP_TEXT, LLIST_DUMP_BINARY } lldump_format_t;
+
 struct llist_t
 {
   llnode_t * head;        /* First element        */
   llnode_t * tail;        /* Last element         */
   llorder_type_t order;   /* Element ordering     */
   size_t sz;              /* Size of linked list  */
+  unsigned int flags;     /* llflag_type_t flags  */
+  int reversed;           /* LLIST_DOUBLY_LINKED: */
+                          /* linked tail to head  */
+  llorder_type_t sorted_as; /* LLIST_LAZY_SORT: */
+  size_t sorted_sz;         /* sorted prefix    */
+  llnode_t * finger;      /* Last inserted llnode */
+  adlock_t lock;          /* LLIST_ADAPTIVE_LOCK  */
+#ifdef TSDS_STATS
+  llist_stats_t stats;    /* Instrumentation      */
+  uint64_t held_since;    /* Write lock timestamp */
+#endif
 };
 
+/* Every llnode carries prev, whatever the list's flags:
+** all lists use it for O(1) unlinks, llist_at and finger
+** walks from the closer end, splits and llist_prev, while
+** LLIST_DOUBLY_LINKED only decides how ASC <-> DESC flips
+** are done. On LP64 this grows an llnode from 16 to 24
+** bytes, which glibc's malloc already rounds 16 up to, so
+** per-llnode allocations cost no extra memory there.
+** Lists that must be compact belong in an llpack_t. */
 struct llnode_t
 {
   int data;
   llnode_t * next;
+  llnode_t * prev;
 };
 
 llnode_t * llnode_create(int data);
@@ -26,12 +67,39 @@ void llnode_free(llnode_t * llnode);
 
 llist_t * llist_create(void);
 llist_t * llist_create_with_llorder(llorder_type_t order);
+llist_t * llist_create_with_flags(llorder_type_t order, unsigned int flags);
 void llist_free(llist_t * llist);
-void llist_insert(llist_t * llist, llnode_t * llnode);
+int llist_insert(llist_t * llist, llnode_t * llnode);
+llnode_t * llist_insert_node(llist_t * llist, llnode_t * llnode);
+llnode_t * llist_insert_value(llist_t * llist, int data);
 void llist_delete(llist_t * llist, int data);
 void llist_sort(llist_t * llist, llorder_type_t order);
 void llist_change_llorder(llist_t * llist, llorder_type_t order);
+void llist_apply_order(llist_t * llist);
 llnode_t * llist_at(llist_t * llist, size_t idx);
 llnode_t * llist_get(llist_t * llist, int data);
+size_t llist_range_count(llist_t * llist, int lo, int hi);
+int64_t llist_range_sum(llist_t * llist, int lo, int hi);
+size_t llist_range_copy(llist_t * llist, int lo, int hi, int * out, size_t cap);
+llnode_t * llist_min(llist_t * llist);
+llnode_t * llist_max(llist_t * llist);
+llist_t * llist_union(llist_t * a, llist_t * b, llset_mode_t mode);
+llist_t * llist_intersect(llist_t * a, llist_t * b, llset_mode_t mode);
+llist_t * llist_difference(llist_t * a, llist_t * b, llset_mode_t mode);
+void llist_concat(llist_t * dst, llist_t * src);
+llist_t * llist_split_at(llist_t * llist, size_t idx);
+llist_t * llist_split_by_value(llist_t * llist, int pivot);
+llnode_t * llist_first(llist_t const * llist);
+llnode_t * llist_last(llist_t const * llist);
+llnode_t * llist_next(llist_t const * llist, llnode_t const * llnode);
+llnode_t * llist_prev(llist_t const * llist, llnode_t const * llnode);
+int llist_save(llist_t * llist, int fd);
+llist_t * llist_load(int fd);
+int llist_dump(llist_t * llist, int fd, lldump_format_t format);
+size_t llist_to_array(llist_t * llist, int * out, size_t cap);
+llist_t * llist_from_array(llorder_type_t order, int const * in, size_t n);
+int llist_lock_stats(llist_t * llist, adlock_stats_t * stats);
+int llist_stats(llist_t * llist, llist_stats_t * stats);
+void llist_stats_reset(llist_t * llist);
 
 #endif /* LLIST_H */
@@ -0,0 +1,55 @@
+#ifndef LLMAP_H
+#define LLMAP_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "./llist.h"
+
+/* A read-mostly list served straight from a memory-mapped
+** file. Nodes refer to each other by byte offsets from the
+** start of the file, so opening a map does no deserializing.
+**
+** The file is mapped private: unlinking a node only dirties
+** the pages it touches in the calling process and never
+** modifies the file. Inserted values live in an in-memory
+** overlay list until llmap_compact writes a new file. */
+
+typedef struct llmap_t llmap_t;
+typedef struct llmap_iter_t llmap_iter_t;
+
+struct llmap_t
+{
+  char * base;            /* Start of the mapping     */
+  size_t len;             /* Length of the mapping    */
+  uint64_t head;          /* Offset of first node     */
+  uint64_t node_count;    /* Longest valid chain      */
+  llorder_type_t order;   /* Element ordering         */
+  size_t sz;              /* Mapped + overlay values  */
+  llist_t * overlay;      /* Values inserted via map  */
+  pthread_rwlock_t rwlock;
+};
+
+struct llmap_iter_t
+{
+  llmap_t * map;
+  uint64_t off;           /* Next mapped node         */
+  uint64_t steps;         /* Mapped nodes yielded     */
+  llnode_t * llnode;      /* Next overlay node        */
+};
+
+int llmap_write(llist_t * llist, char const * path);
+llmap_t * llmap_open(char const * path);
+void llmap_close(llmap_t * map);
+int llmap_compact(llmap_t * map, char const * path);
+
+int llmap_contains(llmap_t * map, int data);
+int llmap_at(llmap_t * map, size_t idx, int * data);
+void llmap_insert(llmap_t * map, int data);
+int llmap_delete(llmap_t * map, int data);
+
+void llmap_iter_begin(llmap_t * map, llmap_iter_t * it);
+int llmap_iter_next(llmap_iter_t * it, int * data);
+void llmap_iter_end(llmap_iter_t * it);
+
+#endif /* LLMAP_H */
@@ -0,0 +1,57 @@
+#ifndef LLPACK_H
+#define LLPACK_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "./llist.h"
+
+/* A compressed ordered list of ints. Values are kept
+** ascending in blocks of at most LLPACK_BLOCK_VALUES,
+** each storing its first value followed by the gaps to
+** the next values as varints. A sorted array of block
+** descriptors indexes the blocks by value range.
+**
+** There are no per-value llnodes, so lookups return
+** values rather than llnode_t pointers. DESC packs store
+** the same blocks and only differ in llpack_at order. */
+
+#define LLPACK_BLOCK_VALUES 128
+
+typedef struct llpack_t llpack_t;
+typedef struct llpack_block_t llpack_block_t;
+
+struct llpack_block_t
+{
+  int32_t first;          /* Smallest value           */
+  int32_t last;           /* Largest value            */
+  uint32_t count;         /* Values in block          */
+  uint32_t len;           /* Bytes of encoded gaps    */
+  uint8_t * gaps;         /* Varint gaps after first  */
+};
+
+struct llpack_t
+{
+  llpack_block_t * blocks;  /* Sorted by value        */
+  size_t num_blocks;
+  size_t cap_blocks;
+  llorder_type_t order;     /* ASC or DESC            */
+  size_t sz;                /* Number of values       */
+  pthread_rwlock_t rwlock;
+};
+
+llpack_t * llpack_create(llorder_type_t order);
+llpack_t * llpack_from_llist(llist_t * llist);
+void llpack_free(llpack_t * pack);
+
+int llpack_insert(llpack_t * pack, int data);
+int llpack_delete(llpack_t * pack, int data);
+int llpack_contains(llpack_t * pack, int data);
+int llpack_at(llpack_t * pack, size_t idx, int * data);
+
+size_t llpack_range_count(llpack_t * pack, int lo, int hi);
+int64_t llpack_range_sum(llpack_t * pack, int lo, int hi);
+size_t llpack_range_copy(llpack_t * pack, int lo, int hi, int * out, size_t cap);
+size_t llpack_bytes(llpack_t * pack);
+
+#endif /* LLPACK_H */
@@ -0,0 +1,65 @@
+#ifndef LLROAR_H
+#define LLROAR_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "./llist.h"
+
+/* A duplicate-free set of ints in roaring layout. Values
+** are split by their high 16 bits into containers, each
+** holding the low 16 bits of its values as a sorted
+** array, a 2^16 bit bitmap or a list of runs, whichever
+** suits its density. Containers are kept sorted by key,
+** so the set iterates in ascending order.
+**
+** Like llpack_t, a set has no llnodes: lookups return
+** values rather than llnode_t pointers. */
+
+#define LLROAR_ARRAY_MAX   4096   /* Larger arrays become bitmaps */
+#define LLROAR_BITMAP_WORDS 1024  /* 2^16 bits                    */
+
+typedef enum { LLROAR_ARRAY, LLROAR_BITMAP, LLROAR_RUN } llroar_container_type_t;
+
+typedef struct llroar_t llroar_t;
+typedef struct llroar_container_t llroar_container_t;
+
+struct llroar_container_t
+{
+  uint16_t key;           /* High 16 bits of values     */
+  uint8_t type;           /* llroar_container_type_t    */
+  uint32_t card;          /* Number of values           */
+  uint32_t n;             /* Array values or runs used  */
+  uint32_t cap;           /* Array values or runs room  */
+  void * data;            /* uint16_t values, uint64_t  */
+                          /* words or uint16_t pairs of */
+                          /* run start and length - 1   */
+};
+
+struct llroar_t
+{
+  llroar_container_t * containers;  /* Sorted by key  */
+  size_t num_containers;
+  size_t cap_containers;
+  size_t sz;                        /* Number of values */
+  pthread_rwlock_t rwlock;
+};
+
+llroar_t * llroar_create(void);
+llroar_t * llroar_from_llist(llist_t * llist);
+void llroar_free(llroar_t * roar);
+
+int llroar_insert(llroar_t * roar, int data);
+int llroar_delete(llroar_t * roar, int data);
+int llroar_contains(llroar_t * roar, int data);
+int llroar_at(llroar_t * roar, size_t idx, int * data);
+size_t llroar_to_array(llroar_t * roar, int * out, size_t cap);
+
+llroar_t * llroar_and(llroar_t * a, llroar_t * b);
+llroar_t * llroar_or(llroar_t * a, llroar_t * b);
+llroar_t * llroar_andnot(llroar_t * a, llroar_t * b);
+
+void llroar_optimize(llroar_t * roar);
+size_t llroar_bytes(llroar_t * roar);
+
+#endif /* LLROAR_H */
@@ -0,0 +1,58 @@
+#ifndef LLSTATS_H
+#define LLSTATS_H
+
+#include <stdint.h>
+
+/* Histogram bucket i counts samples in [2^(i-1), 2^i),
+** bucket 0 counts zero samples and the last bucket
+** collects everything that does not fit elsewhere. */
+#define LLSTATS_HIST_BUCKETS 32
+
+typedef struct llstats_hist_t llstats_hist_t;
+typedef struct llist_stats_t llist_stats_t;
+
+struct llstats_hist_t
+{
+  uint64_t count;         /* Samples recorded   */
+  uint64_t sum;           /* Sum of all samples */
+  uint64_t max;           /* Largest sample     */
+  uint64_t buckets[LLSTATS_HIST_BUCKETS];
+};
+
+struct llist_stats_t
+{
+  uint64_t inserts;
+  uint64_t deletes;
+  uint64_t gets;
+  uint64_t ats;
+  uint64_t sorts;
+  uint64_t order_changes;
+  llstats_hist_t write_wait;    /* ns spent acquiring the write lock        */
+  llstats_hist_t write_hold;    /* ns the write lock was held               */
+  llstats_hist_t read_wait;     /* ns spent entering as a reader            */
+  llstats_hist_t read_hold;     /* ns spent inside a read section           */
+  llstats_hist_t handoff_wait;  /* ns the first reader waited on the others */
+  llstats_hist_t traversal;     /* llnodes visited per operation            */
+};
+
+/* Instrumentation is compiled in only when TSDS_STATS is
+** defined (`make STATS=1`). Otherwise these macros expand
+** to nothing and their arguments are never evaluated. */
+#ifdef TSDS_STATS
+#define LLSTATS_ONLY(...)               __VA_ARGS__
+#define LLSTATS_INC(llist, field)       llstats_add(&(llist)->stats.field, 1)
+#define LLSTATS_RECORD(llist, hist, v)  llstats_record(&(llist)->stats.hist, (v))
+#else
+#define LLSTATS_ONLY(...)
+#define LLSTATS_INC(llist, field)       ((void)0)
+#define LLSTATS_RECORD(llist, hist, v)  ((void)0)
+#endif
+
+uint64_t llstats_now(void);
+void llstats_add(uint64_t * counter, uint64_t n);
+void llstats_record(llstats_hist_t * hist, uint64_t v);
+void llstats_copy(llist_stats_t * dst, llist_stats_t * src);
+void llstats_reset(llist_stats_t * stats);
+uint64_t llstats_percentile(llstats_hist_t const * hist, double p);
+
+#endif /* LLSTATS_H */
@@ -0,0 +1,161 @@
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../headers/adlock.h"
+
+#define LOCK_FREE      0
+#define LOCK_HELD      1
+#define LOCK_CONTENDED 2
+
+/*-----------------------------------*/
+/* Helper Functions Declarations     */
+/*-----------------------------------*/
+static void _adlock_cpu_relax(void);
+static void _adlock_park(int *, int);
+static void _adlock_unpark(int *);
+static void _adlock_stat_add(uint64_t *, uint64_t);
+static int _adlock_try_acquire(adlock_t *);
+
+/*-----------------------------------*/
+/* Function Definitions              */
+/*-----------------------------------*/
+
+void
+adlock_init(adlock_t * lock, unsigned int spin_rounds)
+/* Initializes lock as free. A waiter spins through
+** spin_rounds rounds of exponential backoff before
+** it parks.
+**/
+{
+  lock->state = LOCK_FREE;
+  lock->spin_rounds = spin_rounds;
+  lock->stats.acquires = 0;
+  lock->stats.contended = 0;
+  lock->stats.spins = 0;
+  lock->stats.parks = 0;
+}
+
+void
+adlock_acquire(adlock_t * lock)
+/* Acquires lock. Spins with exponential backoff while
+** the holder is likely to release it soon and parks
+** the calling thread once the spin budget runs out.
+**/
+{
+  unsigned int round;
+  int i, state;
+
+  if (_adlock_try_acquire(lock))
+  {
+    _adlock_stat_add(&lock->stats.acquires, 1);
+    return;
+  }
+  _adlock_stat_add(&lock->stats.contended, 1);
+
+  for (round = 0; round < lock->spin_rounds; round++)
+  {
+    for (i = 0; i < (1 << round); i++)
+      _adlock_cpu_relax();
+
+    _adlock_stat_add(&lock->stats.spins, 1);
+
+    if (__atomic_load_n(&lock->state, __ATOMIC_RELAXED) == LOCK_FREE
+        && _adlock_try_acquire(lock))
+    {
+      _adlock_stat_add(&lock->stats.acquires, 1);
+      return;
+    }
+  }
+
+  /* Marks the lock as contended so the holder knows
+     it must wake a parked waiter on release */
+  state = __atomic_exchange_n(&lock->state, LOCK_CONTENDED, __ATOMIC_ACQUIRE);
+  while (state != LOCK_FREE)
+  {
+    _adlock_stat_add(&lock->stats.parks, 1);
+    _adlock_park(&lock->state, LOCK_CONTENDED);
+    state = __atomic_exchange_n(&lock->state, LOCK_CONTENDED, __ATOMIC_ACQUIRE);
+  }
+  _adlock_stat_add(&lock->stats.acquires, 1);
+}
+
+void
+adlock_release(adlock_t * lock)
+/* Releases lock and wakes one parked waiter if any
+** thread parked while the lock was held.
+**/
+{
+  if (__atomic_exchange_n(&lock->state, LOCK_FREE, __ATOMIC_RELEASE) == LOCK_CONTENDED)
+    _adlock_unpark(&lock->state);
+}
+
+void
+adlock_get_stats(adlock_t * lock, adlock_stats_t * stats)
+/* Copies a snapshot of lock's counters into stats.
+** Counters are read individually and may be slightly
+** out of sync with each other under contention.
+**/
+{
+  stats->acquires = __atomic_load_n(&lock->stats.acquires, __ATOMIC_RELAXED);
+  stats->contended = __atomic_load_n(&lock->stats.contended, __ATOMIC_RELAXED);
+  stats->spins = __atomic_load_n(&lock->stats.spins, __ATOMIC_RELAXED);
+  stats->parks = __atomic_load_n(&lock->stats.parks, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */ 
+/*-----------------------------------*/
+
+static int
+_adlock_try_acquire(adlock_t * lock)
+{
+  int expected = LOCK_FREE;
+  return __atomic_compare_exchange_n(&lock->state, &expected, LOCK_HELD, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void
+_adlock_stat_add(uint64_t * counter, uint64_t n)
+{
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+static void
+_adlock_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static void
+_adlock_park(int * addr, int val)
+/* Sleeps while *addr == val. Falls back to yielding
+** the processor where futexes are not available.
+**/
+{
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+  (void)addr;
+  (void)val;
+  sched_yield();
+#endif
+}
+
+static void
+_adlock_unpark(int * addr)
+{
+#ifdef __linux__
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void)addr;
+#endif
+}
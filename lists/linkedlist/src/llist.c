@@ -1,31 +1,83 @@
 #include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <sys/types.h>
 
 #include "../headers/llist.h"
+#include "../headers/llio.h"
 #include "../headers/utils.h"
 
 #define DEBUG 0
 
+/* Snapshot format: an llsnap_header_t followed by sz
+** packed int32_t values in list order. All fields use
+** the byte order of the machine that wrote them. */
+#define LLSNAP_MAGIC   "TSDL"
+#define LLSNAP_VERSION 1
+#define LLSNAP_CHUNK   4096   /* Values buffered per write */
+
+/* Set operations merged by _llist_set_op */
+typedef enum { LLSET_UNION, LLSET_INTERSECT, LLSET_DIFFERENCE } llset_op_t;
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t order;
+  uint32_t reserved;
+  uint64_t sz;
+} llsnap_header_t;
+
 /*-----------------------------------*/
 /* Helper Functions Declarations     */
 /*-----------------------------------*/
 static void _llist_init(llist_t *);
 static void _llist_init_with_llorder(llist_t *, llorder_type_t);
-static void _llist_insert_asc(llist_t *, llnode_t *);
-static void _llist_insert_desc(llist_t *, llnode_t *);
+static int _llist_insert_llnode(llist_t *, llnode_t *, llnode_t **);
 static void _llist_insert_unordered(llist_t *, llnode_t *);
-static void _llist_acquire_writers_lock(void);
-static void _llist_release_writers_lock(void);
+static void _llist_link_after(llist_t *, llnode_t *, llnode_t *);
+static void _llist_unlink(llist_t *, llnode_t *);
+static llorder_type_t _llist_phys_order(llist_t const *);
+static void _llist_lock(llist_t *);
+static void _llist_unlock(llist_t *);
+static void _llist_acquire_writers_lock(llist_t *);
+static void _llist_release_writers_lock(llist_t *);
 static void _llist_reverse(llist_t *);
 static void _llist_reorder_llnodes_in_llist(llist_t *, llnode_t **);
 static void _llist_sort(llist_t *, llorder_type_t);
+static int _llist_order_pending(llist_t const *);
+static void _llist_apply_order(llist_t *);
+static int _llist_acquire_ordered_read(llist_t *);
+static void _llist_release_ordered_read(llist_t *, int);
 static int _llist_asc_comparitor(void const *, void const *);
 static int _llist_desc_comparitor(void const *, void const *);
-static llnode_t * _llist_get_prev_llnode(llist_t *, int);
-static llnode_t * _llist_extract_llnode(llist_t *, int);
+static llnode_t * _llist_get_prev_llnode(llist_t *, llorder_type_t, int);
+static llnode_t * _llist_find_llnode(llist_t *, int);
+static int _llist_precedes(llorder_type_t, int, int);
+static llnode_t * _llist_extract_llnode(llist_t *, int, size_t *);
 static llnode_t * _llist_get_llnode_at(llist_t *, size_t);
 static llnode_t ** _llist_make_llnode_array(llist_t *);
+static llnode_t * _llist_range_seek(llist_t const *, int);
+static llnode_t * _llist_range_next(llist_t const *, llnode_t const *);
+static size_t _llist_range_walk(llist_t *, int, int, int *, size_t, int64_t *);
+static llnode_t * _llist_extremum(llist_t *, int);
+static void _llist_lock_pair(llist_t *, llist_t *);
+static void _llist_unlock_pair(llist_t *, llist_t *);
+static llist_t * _llist_set_op(llist_t *, llist_t *, llset_op_t, llset_mode_t);
+static int _llist_set_take(llist_t *, llist_t *, llnode_t *, llset_mode_t);
+static void _llist_make_ascending(llist_t *);
+static void _llist_cut(llist_t *, llist_t *, size_t, int);
+static int _llist_write_values(llist_t *, int, lldump_format_t);
+static size_t _llist_format_int(char *, int);
+static int _llist_link_values(llist_t *, int32_t *, size_t);
+static int _llist_int32_asc_comparitor(void const *, void const *);
+static int _llist_int32_desc_comparitor(void const *, void const *);
+static int _llist_read_all(int, void *, size_t);
+static int _llist_is_sorted(int32_t const *, size_t, llorder_type_t);
 
 /* Mutexes */
 static pthread_mutex_t mtx   = PTHREAD_MUTEX_INITIALIZER;  /* General mutex        */
@@ -46,6 +98,11 @@ static struct {
   0
 };
 
+#ifdef TSDS_STATS
+/* Start of the calling thread's current read section */
+static __thread uint64_t read_since;
+#endif
+
 /*-----------------------------------*/
 /* Function Definitions              */
 /*-----------------------------------*/
@@ -60,6 +117,7 @@ llnode_create(int data)
   {
     llnode->data = data;
     llnode->next = NULL;
+    llnode->prev = NULL;
   }
   return llnode;
 }
@@ -74,6 +132,7 @@ llnode_free(llnode_t * llnode)
 
   llnode->data = 0;
   llnode->next = NULL;
+  llnode->prev = NULL;
   free(llnode);
   llnode = NULL;
 }
@@ -101,6 +160,22 @@ llist_create_with_llorder(llorder_type_t order)
   return llist;
 }
 
+llist_t *
+llist_create_with_flags(llorder_type_t order, unsigned int flags)
+/* Creates a new linked list with the specified llorder_type_t
+** and llflag_type_t flags.
+**/
+{
+  llist_t * llist = llist_create_with_llorder(order);
+  if (llist)
+  {
+    llist->flags = flags;
+    if (flags & LLIST_ADAPTIVE_LOCK)
+      adlock_init(&llist->lock, ADLOCK_DEFAULT_SPIN_ROUNDS);
+  }
+  return llist;
+}
+
 void
 llist_free(llist_t * llist)
 /* Frees memory allocated for linked list.
@@ -111,8 +186,7 @@ llist_free(llist_t * llist)
   if (llist == NULL)
     return;
 
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&w_mtx);
+  _llist_lock(llist);
   if (llist)
   {
     llnode_t * cur = llist->head;
@@ -125,42 +199,68 @@ llist_free(llist_t * llist)
     llist->sz = 0;
     llist->head = NULL;
     llist->tail = NULL;
-    free(llist);
-    llist = NULL;
   }
-  pthread_mutex_unlock(&w_mtx);
-  pthread_mutex_unlock(&mtx);
+  /* Lock may live inside llist, so it is released
+     before llist itself is freed */
+  _llist_unlock(llist);
+  free(llist);
 }
 
-void
+int
 llist_insert(llist_t * llist, llnode_t * llnode)
 /* Inserts the llnode into the linked list in accordance
 ** to to the list's order type and increments the size
-** of the linked list by one.
+** of the linked list by one. Returns 0 on success, 1 if
+** a LLIST_UNIQUE list already holds llnode's value, in
+** which case llnode is freed, and -1 on error.
 **/
 {
-  /* Avoids unnecessary locking/unlocking 
-     of mutexes */
-  if (llist == NULL)
-    return;
+  llnode_t * kept;
+  return _llist_insert_llnode(llist, llnode, &kept);
+}
 
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&w_mtx);
-  if (llist && llnode)
-  {
-    if (llist->order == ASC)
-      _llist_insert_asc(llist, llnode);
+llnode_t *
+llist_insert_node(llist_t * llist, llnode_t * llnode)
+/* Same as llist_insert(...) but returns the llnode that
+** holds llnode's value afterwards: llnode itself, or for
+** a LLIST_UNIQUE list that already held the value, the
+** llnode already in the list. Returns NULL on error.
+**/
+{
+  llnode_t * kept = NULL;
+  _llist_insert_llnode(llist, llnode, &kept);
+  return kept;
+}
+
+llnode_t *
+llist_insert_value(llist_t * llist, int data)
+/* Inserts a new llnode containing data and returns it.
+** A LLIST_UNIQUE list is first probed under the read
+** lock, so a value already present is returned without
+** allocating or taking the write lock. Returns NULL on
+** error.
+**/
+{
+  llnode_t * llnode;
 
-    else if (llist->order == DESC)
-      _llist_insert_desc(llist, llnode);
+  if (llist == NULL)
+    return NULL;
 
-    else
-      _llist_insert_unordered(llist, llnode);
+  if (llist->flags & LLIST_UNIQUE)
+  {
+    _llist_acquire_writers_lock(llist);
+    llnode = _llist_find_llnode(llist, data);
+    LLSTATS_INC(llist, gets);
+    _llist_release_writers_lock(llist);
 
-    llist->sz++;
+    if (llnode)
+      return llnode;
   }
-  pthread_mutex_unlock(&w_mtx);
-  pthread_mutex_unlock(&mtx);
+
+  llnode = llnode_create(data);
+  if (llnode == NULL)
+    return NULL;
+  return llist_insert_node(llist, llnode);
 }
 
 void
@@ -174,27 +274,29 @@ llist_delete(llist_t * llist, int data)
   if (llist == NULL)
     return;
 
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&w_mtx);
+  _llist_lock(llist);
   if (llist)
   {
-    llnode_t * extracted_llnode = _llist_extract_llnode(llist, data);
+    size_t pos;
+    llnode_t * extracted_llnode = _llist_extract_llnode(llist, data, &pos);
 
     if (extracted_llnode)
     {
+      if (pos < llist->sorted_sz)
+        llist->sorted_sz--;
+
       if (extracted_llnode->data != data) /* Internal error */
       {
-        pthread_mutex_unlock(&mtx);
-        pthread_mutex_unlock(&w_mtx);
+        _llist_unlock(llist);
         return;
       }
 
       llnode_free(extracted_llnode);
       llist->sz--;
     }
+    LLSTATS_INC(llist, deletes);
   }
-  pthread_mutex_unlock(&mtx);
-  pthread_mutex_unlock(&w_mtx);
+  _llist_unlock(llist);
 }
 
 void
@@ -209,14 +311,15 @@ llist_sort(llist_t * llist, llorder_type_t order)
       || order == NONE)
     return;
 
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&w_mtx);
+  _llist_lock(llist);
 
   if (llist)
+  {
     _llist_sort(llist, order);
+    LLSTATS_INC(llist, sorts);
+  }
 
-  pthread_mutex_unlock(&w_mtx);
-  pthread_mutex_unlock(&mtx);
+  _llist_unlock(llist);
 }
 
 void
@@ -230,8 +333,7 @@ llist_change_llorder(llist_t * llist, llorder_type_t order)
   if (llist == NULL)
     return;
 
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&w_mtx);
+  _llist_lock(llist);
 
   // DEBUG
   if (DEBUG)
@@ -239,22 +341,33 @@ llist_change_llorder(llist_t * llist, llorder_type_t order)
 
   if (llist && llist->order != order)
   {
-    /* Implies that order goes from
-       NONE -> ASC | DESC */
-    if (llist->order == NONE)
-      _llist_sort(llist, order);
-
-    /* Implies that order goes from
-       ASC  -> DESC
-            or
-       DESC -> ASC */
-    else if (order != NONE)
-      _llist_reverse(llist);
+    /* Lazy lists only record the new order, it is
+       applied by the next read that depends on it */
+    if (!(llist->flags & LLIST_LAZY_SORT))
+    {
+      /* Implies that order goes from
+         NONE -> ASC | DESC */
+      if (llist->order == NONE)
+        _llist_sort(llist, order);
+
+      /* Implies that order goes from
+         ASC  -> DESC
+              or
+         DESC -> ASC.
+         Doubly linked lists only flip their direction */
+      else if (order != NONE)
+      {
+        if (llist->flags & LLIST_DOUBLY_LINKED)
+          llist->reversed = !llist->reversed;
+        else
+          _llist_reverse(llist);
+      }
+    }
 
     llist->order = order;
+    LLSTATS_INC(llist, order_changes);
   }
-  pthread_mutex_unlock(&w_mtx);
-  pthread_mutex_unlock(&mtx);
+  _llist_unlock(llist);
 }
 
 llnode_t * 
@@ -269,14 +382,17 @@ llist_at(llist_t * llist, size_t idx)
     return NULL;
 
   llnode_t * llnode = NULL;
-  _llist_acquire_writers_lock();
+  int exclusive = _llist_acquire_ordered_read(llist);
   if (llist
       && idx >= 0
       && idx < llist->sz)
   {
+    if (llist->reversed)
+      idx = llist->sz - 1 - idx;
     llnode = _llist_get_llnode_at(llist, idx);
   }
-  _llist_release_writers_lock();
+  LLSTATS_INC(llist, ats);
+  _llist_release_ordered_read(llist, exclusive);
 
   return llnode;
 }
@@ -292,248 +408,1072 @@ llist_get(llist_t * llist, int data)
   if (llist == NULL)
     return NULL;
 
-  _llist_acquire_writers_lock();
+  _llist_acquire_writers_lock(llist);
   llnode_t * llnode = NULL;
   if (llist)
   {
-    llnode = llist->head;
+    LLSTATS_ONLY(uint64_t steps = 0;)
+    llnode = llist_first(llist);
     while (llnode && llnode->data != data)
-      llnode = llnode->next;
+    {
+      llnode = llist_next(llist, llnode);
+      LLSTATS_ONLY(steps++;)
+    }
+    LLSTATS_RECORD(llist, traversal, steps);
+    LLSTATS_INC(llist, gets);
   }
-  _llist_release_writers_lock();
+  _llist_release_writers_lock(llist);
   return llnode;
 }
 
-/*-----------------------------------*/
-/* Helper Functions                  */ 
-/*-----------------------------------*/
+int
+llist_lock_stats(llist_t * llist, adlock_stats_t * stats)
+/* Copies the lock counters of llist into stats. Returns
+** 0 on success or -1 if llist does not use an adaptive
+** lock.
+**/
+{
+  if (llist == NULL
+      || stats == NULL
+      || !(llist->flags & LLIST_ADAPTIVE_LOCK))
+    return -1;
 
-static void 
-_llist_init(llist_t * llist)
-/* Initializes linked list and sets llorder_type_t to
-** unordered. llist should always be a valid pointer.
+  adlock_get_stats(&llist->lock, stats);
+  return 0;
+}
+
+void
+llist_apply_order(llist_t * llist)
+/* Applies a deferred order change of a LLIST_LAZY_SORT
+** list now instead of on the next order-dependent read.
+** Does nothing for other lists.
 **/
 {
-  llist->head = NULL;
-  llist->tail = NULL;
-  llist->order = NONE;
-  llist->sz = 0;
+  if (llist == NULL)
+    return;
+
+  _llist_lock(llist);
+  _llist_apply_order(llist);
+  _llist_unlock(llist);
 }
 
-static void 
-_llist_init_with_llorder(llist_t * llist, llorder_type_t order)
-/* Initializes linked list and sets llorder_type_t to
-** specified order. llist should always be a valid
-** pointer.
+size_t
+llist_range_count(llist_t * llist, int lo, int hi)
+/* Returns the number of elements in [lo, hi].
 **/
 {
-  _llist_init(llist);
-  llist->order = order;
+  return _llist_range_walk(llist, lo, hi, NULL, SIZE_MAX, NULL);
 }
 
-static void
-_llist_insert_asc(llist_t * llist, llnode_t * llnode)
-/* Inserts llnode into linked list in ascending order.
-** This function should not be called if llist or llnode
-** are NULL.
+int64_t
+llist_range_sum(llist_t * llist, int lo, int hi)
+/* Returns the sum of the elements in [lo, hi].
 **/
 {
-  int data = llnode->data;
-  llnode_t * prev_llnode = _llist_get_prev_llnode(llist, data);
+  int64_t sum = 0;
+  _llist_range_walk(llist, lo, hi, NULL, SIZE_MAX, &sum);
+  return sum;
+}
 
-  /* Node to insert will be new HEAD */
-  if (prev_llnode == NULL) 
-  {
-    llnode->next = llist->head;
-    llist->head = llnode;
+size_t
+llist_range_copy(llist_t * llist, int lo, int hi, int * out, size_t cap)
+/* Copies up to cap elements in [lo, hi] into out, in
+** ascending order for ordered lists and in list order
+** otherwise. Returns the number of elements copied.
+**/
+{
+  if (out == NULL)
+    return 0;
+  return _llist_range_walk(llist, lo, hi, out, cap, NULL);
+}
 
-    /* Handles case where llist is empty */
-    if (llist->sz == 0) 
-      llist->tail = llnode;
-  }
-  else
-  {
-    /* Node to insert will be new TAIL */
-    if (prev_llnode->next == NULL) 
-    {
-      prev_llnode->next = llnode;
-      llist->tail = llnode;
-    }
-    else
-    {
-      llnode->next = prev_llnode->next;
-      prev_llnode->next = llnode;
-    }
-  }
+llnode_t *
+llist_min(llist_t * llist)
+/* Returns the llnode containing the smallest element, or
+** NULL if llist is empty. Constant time for ASC and DESC
+** lists, a full scan for unordered ones.
+**/
+{
+  return _llist_extremum(llist, 0);
 }
 
-static void
-_llist_insert_desc(llist_t * llist, llnode_t * llnode)
-/* Inserts llnode into linked list in descending order
-** This function should not be called if llist or llnode
-** are NULL.
+llnode_t *
+llist_max(llist_t * llist)
+/* Returns the llnode containing the largest element, or
+** NULL if llist is empty. Constant time for ASC and DESC
+** lists, a full scan for unordered ones.
 **/
 {
-  int data = llnode->data;
-  llnode_t * prev_llnode = _llist_get_prev_llnode(llist, data);
+  return _llist_extremum(llist, 1);
+}
 
-  /* Node to insert will be new HEAD */
-  if (prev_llnode == NULL) 
-  {
-    llnode->next = llist->head;
-    llist->head = llnode;
+llist_t *
+llist_union(llist_t * a, llist_t * b, llset_mode_t mode)
+/* Returns a new list with the elements of a or b, in
+** the order of a. Values present in both are taken from
+** a, as many times as they appear in whichever list has
+** more of them. Both lists must be ordered. With
+** LLIST_SET_MOVE the llnodes of the result are removed
+** from a and b instead of copied. Returns NULL on error.
+**/
+{
+  return _llist_set_op(a, b, LLSET_UNION, mode);
+}
+
+llist_t *
+llist_intersect(llist_t * a, llist_t * b, llset_mode_t mode)
+/* Returns a new list with the elements of a that are
+** also in b, each value as many times as it appears in
+** both, in the order of a. See llist_union for modes.
+**/
+{
+  return _llist_set_op(a, b, LLSET_INTERSECT, mode);
+}
+
+llist_t *
+llist_difference(llist_t * a, llist_t * b, llset_mode_t mode)
+/* Returns a new list with the elements of a that are
+** not matched by an element of b, in the order of a.
+** See llist_union for modes.
+**/
+{
+  return _llist_set_op(a, b, LLSET_DIFFERENCE, mode);
+}
+
+void
+llist_concat(llist_t * dst, llist_t * src)
+/* Moves every llnode of src into dst, leaving src empty.
+** Unordered lists are relinked in constant time after
+** the logical end of dst, ordered lists are merged in
+** linear time. Nothing is allocated. A LLIST_UNIQUE dst
+** frees the llnodes whose value it already holds; when
+** unordered, each llnode then costs a scan of dst.
+**/
+{
+  llnode_t * cur;
+  int unique;
+
+  if (dst == NULL || src == NULL || dst == src)
+    return;
+
+  _llist_lock_pair(dst, src);
+  _llist_apply_order(dst);
+  _llist_apply_order(src);
+  unique = dst->flags & LLIST_UNIQUE;
 
-    /* Handles case where llist is empty */
-    if (llist->sz == 0) 
-      llist->tail = llnode;
+  if (src->head && dst->order == NONE && unique)
+  {
+    while ((cur = llist_first(src)))
+    {
+      _llist_unlink(src, cur);
+      if (_llist_find_llnode(dst, cur->data))
+        llnode_free(cur);
+      else
+      {
+        _llist_insert_unordered(dst, cur);
+        dst->sz++;
+      }
+    }
   }
-  else
+
+  else if (src->head && dst->order == NONE)
   {
-    /* Node to insert will be new TAIL */
-    if (prev_llnode->next == NULL) 
+    /* A list stored reversed is appended by linking it
+       in front of the physical head of dst */
+    if (src->reversed != dst->reversed)
+      _llist_reverse(src);
+
+    if (dst->head == NULL)
     {
-      prev_llnode->next = llnode;
-      llist->tail = llnode;
+      dst->head = src->head;
+      dst->tail = src->tail;
+    }
+    else if (dst->reversed)
+    {
+      src->tail->next = dst->head;
+      dst->head->prev = src->tail;
+      dst->head = src->head;
     }
     else
     {
-      llnode->next = prev_llnode->next;
-      prev_llnode->next = llnode;
+      dst->tail->next = src->head;
+      src->head->prev = dst->tail;
+      dst->tail = src->tail;
     }
+    dst->sz += src->sz;
   }
-}
 
-static void
-_llist_insert_unordered(llist_t * llist, llnode_t * llnode)
-/* Appends llnode to end of linked list. This function
-** should not be called if llist or llnode are NULL.
-**/
-{
-  if (llist->sz == 0)
-    llist->head = llist->tail = llnode;
-  else 
+  else if (src->head)
   {
-    llist->tail->next = llnode;
-    llist->tail = llnode;
+    llnode_t * nb;
+    llnode_t * na;
+
+    _llist_make_ascending(dst);
+    if (src->order == NONE)
+      _llist_sort(src, ASC);
+    else
+      _llist_make_ascending(src);
+
+    na = dst->head;
+    nb = src->head;
+    dst->head = dst->tail = NULL;
+    dst->sz = 0;
+    while (na || nb)
+    {
+      if (na && (nb == NULL || na->data <= nb->data))
+      {
+        cur = na;
+        na = na->next;
+      }
+      else
+      {
+        cur = nb;
+        nb = nb->next;
+      }
+
+      /* Ties take dst's llnode first */
+      if (unique && dst->tail && dst->tail->data == cur->data)
+      {
+        llnode_free(cur);
+        continue;
+      }
+
+      cur->prev = dst->tail;
+      cur->next = NULL;
+      if (dst->tail)
+        dst->tail->next = cur;
+      else
+        dst->head = cur;
+      dst->tail = cur;
+      dst->sz++;
+    }
+
+    if (dst->order == DESC)
+      _llist_reverse(dst);
+    dst->sorted_sz = dst->sz;
   }
+
+  src->head = src->tail = NULL;
+  src->finger = NULL;
+  src->reversed = 0;
+  src->sz = 0;
+  src->sorted_sz = 0;
+
+  _llist_unlock_pair(dst, src);
 }
 
-static void
-_llist_acquire_writers_lock(void)
-/* The first thread to call this function acquires
-** a lock on writers' mutex w_mtx and sets itself
-** as the first reader in the reader structure.
+llist_t *
+llist_split_at(llist_t * llist, size_t idx)
+/* Moves the llnodes at positions idx and up into a new
+** list with the same order and flags, and returns it.
+** Returns NULL if idx is out of bounds.
 **/
 {
-  pthread_mutex_lock(&mtx);
-  pthread_mutex_lock(&reader.mtx);
-  /* First reader locks writer mutex */
-  if (!reader.entered)
+  llist_t * res;
+
+  if (llist == NULL)
+    return NULL;
+
+  res = llist_create_with_flags(NONE, llist->flags);
+  if (res == NULL)
+    return NULL;
+
+  _llist_lock(llist);
+  _llist_apply_order(llist);
+  if (idx > llist->sz)
   {
-    reader.entered = 1;
-    reader.first_reader = pthread_self();
-    pthread_mutex_lock(&w_mtx);
+    _llist_unlock(llist);
+    llist_free(res);
+    return NULL;
   }
-  reader.cnt++;
-  pthread_mutex_unlock(&reader.mtx);
-  pthread_mutex_unlock(&mtx);
+  _llist_cut(llist, res, idx, 0);
+  _llist_unlock(llist);
+
+  return res;
 }
 
-static void
-_llist_release_writers_lock(void)
-/* The second to last reader signals the first reader,
-** which acquired lock on w_mtx, to release lock on
-** w_mtx.
+llist_t *
+llist_split_by_value(llist_t * llist, int pivot)
+/* Moves the llnodes containing values >= pivot into a
+** new list with the same order and flags, and returns
+** it. Ordered lists are cut at the pivot, unordered
+** lists keep the relative order of both parts.
 **/
 {
-  // DEBUG
-  if (DEBUG)
-    puts("_llist_release_writers_lock(void)");
+  llist_t * res;
+  llnode_t * llnode;
+  llnode_t * next;
+  size_t idx = 0;
 
-  /* First reader releases writer mutex */
-  pthread_mutex_lock(&reader.mtx);
-  if (reader.first_reader == pthread_self())
-  {
-    while (reader.cnt != 1)
-      pthread_cond_wait(&reader.cv, &reader.mtx);
+  if (llist == NULL)
+    return NULL;
 
-    /* Only thread that locked w_mtx can unlock it */
-    pthread_mutex_unlock(&w_mtx); 
+  res = llist_create_with_flags(NONE, llist->flags);
+  if (res == NULL)
+    return NULL;
 
-    reader.cnt--;
-    reader.entered = 0; /* No readers reading */
+  _llist_lock(llist);
+  _llist_apply_order(llist);
+
+  if (llist->order == ASC)
+  {
+    for (llnode = llist_first(llist);
+         llnode && llnode->data < pivot;
+         llnode = llist_next(llist, llnode))
+      idx++;
+    _llist_cut(llist, res, idx, 0);
+  }
+  else if (llist->order == DESC)
+  {
+    for (llnode = llist_first(llist);
+         llnode && llnode->data >= pivot;
+         llnode = llist_next(llist, llnode))
+      idx++;
+    _llist_cut(llist, res, idx, 1);
   }
   else
   {
-    if (--reader.cnt == 1)
-      pthread_cond_signal(&reader.cv);
+    res->reversed = llist->reversed;
+    for (llnode = llist_first(llist); llnode; llnode = next)
+    {
+      next = llist_next(llist, llnode);
+      if (llnode->data >= pivot)
+      {
+        _llist_unlink(llist, llnode);
+        _llist_insert_unordered(res, llnode);
+        llist->sz--;
+        res->sz++;
+      }
+    }
+    llist->sorted_sz = 0;
   }
-  pthread_mutex_unlock(&reader.mtx);
+  _llist_unlock(llist);
+
+  return res;
 }
 
-static void
-_llist_reverse(llist_t * llist)
+llnode_t *
+llist_first(llist_t const * llist)
+/* Returns the first llnode in the list's logical order.
+** Like walking head directly, the accessors below take
+** no lock and must not race with writers.
+**/
 {
-  llnode_t * new_prev;
-  llnode_t * new_next;
-  llnode_t * cur;
-
-  cur = llist->head;
-  llist->head = llist->tail;
-  llist->tail = cur;
-
-  new_next = NULL;
-  new_prev = cur;
-  while (cur)
-  {
-    new_prev = cur->next;
-    cur->next = new_next;
-    new_next = cur;
-    cur = new_prev;
-  }
+  if (llist == NULL)
+    return NULL;
+  return llist->reversed ? llist->tail : llist->head;
 }
 
-static void
-_llist_reorder_llnodes_in_llist(llist_t * llist, llnode_t * llnodes[])
-/* Size of llnodes should always be equal to llist size.
+llnode_t *
+llist_last(llist_t const * llist)
+/* Returns the last llnode in the list's logical order.
 **/
 {
-  size_t sz = llist->sz;
-  llist->head = llnodes[0];
-  llnode_t * cur = llist->head;
-  size_t i;
-  for (i = 1; i < sz && cur; i++)
-  {
-    cur->next = llnodes[i];
-    cur = llnodes[i];
-  }
-  llist->tail = cur;
-  llist->tail->next = NULL;
+  if (llist == NULL)
+    return NULL;
+  return llist->reversed ? llist->head : llist->tail;
 }
 
-static void
-_llist_sort(llist_t * llist, llorder_type_t order)
-/* Sorts llist in the order specified by order. Uses
-** qsort and ascending/descending comparitors to sort.
-** Does not modify the order of the llist itself.
+llnode_t *
+llist_next(llist_t const * llist, llnode_t const * llnode)
+/* Returns the llnode that logically follows llnode.
 **/
 {
-  // DEBUG
-  if (DEBUG)
+  if (llist == NULL || llnode == NULL)
+    return NULL;
+  return llist->reversed ? llnode->prev : llnode->next;
+}
+
+llnode_t *
+llist_prev(llist_t const * llist, llnode_t const * llnode)
+/* Returns the llnode that logically precedes llnode.
+**/
+{
+  if (llist == NULL || llnode == NULL)
+    return NULL;
+  return llist->reversed ? llnode->next : llnode->prev;
+}
+
+int
+llist_save(llist_t * llist, int fd)
+/* Writes a binary snapshot of llist to fd. Values are
+** buffered and written LLSNAP_CHUNK at a time under a
+** single read lock. Returns 0 on success or -1 on error.
+**/
+{
+  llsnap_header_t header;
+  int exclusive;
+  int ret = 0;
+
+  if (llist == NULL || fd < 0)
+    return -1;
+
+  exclusive = _llist_acquire_ordered_read(llist);
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LLSNAP_MAGIC, sizeof(header.magic));
+  header.version = LLSNAP_VERSION;
+  header.order = (uint32_t)llist->order;
+  header.sz = (uint64_t)llist->sz;
+  ret = llio_write_all(fd, &header, sizeof(header));
+
+  if (ret == 0)
+    ret = _llist_write_values(llist, fd, LLIST_DUMP_BINARY);
+
+  _llist_release_ordered_read(llist, exclusive);
+
+  return ret;
+}
+
+llist_t *
+llist_load(int fd)
+/* Creates a new linked list from a snapshot written by
+** llist_save. The values are read with a single read
+** and linked in file order; a list is only re-sorted
+** if its values turn out not to match its order.
+** Returns NULL on error.
+**/
+{
+  llsnap_header_t header;
+  llist_t * llist;
+  int32_t * data;
+
+  if (fd < 0
+      || _llist_read_all(fd, &header, sizeof(header)) != 0
+      || memcmp(header.magic, LLSNAP_MAGIC, sizeof(header.magic)) != 0
+      || header.version != LLSNAP_VERSION
+      || header.order > NONE
+      || header.sz > SIZE_MAX / sizeof(int32_t))
+    return NULL;
+
+  llist = llist_create_with_llorder((llorder_type_t)header.order);
+  if (llist == NULL || header.sz == 0)
+    return llist;
+
+  data = (int32_t *) malloc(sizeof(int32_t) * header.sz);
+  if (data == NULL
+      || _llist_read_all(fd, data, sizeof(int32_t) * header.sz) != 0)
+  {
+    free(data);
+    free(llist);
+    return NULL;
+  }
+
+  if (_llist_link_values(llist, data, header.sz) != 0)
+  {
+    llist_free(llist);
+    llist = NULL;
+  }
+
+  free(data);
+  return llist;
+}
+
+int
+llist_dump(llist_t * llist, int fd, lldump_format_t format)
+/* Writes the values of llist to fd in list order, either
+** as decimal text with one value per line or as packed
+** int32_t values. Output is buffered and written a chunk
+** at a time under a single read lock. Returns 0 on
+** success or -1 on error.
+**/
+{
+  int exclusive;
+  int ret;
+
+  if (llist == NULL || fd < 0)
+    return -1;
+
+  exclusive = _llist_acquire_ordered_read(llist);
+  ret = _llist_write_values(llist, fd, format);
+  _llist_release_ordered_read(llist, exclusive);
+
+  return ret;
+}
+
+size_t
+llist_to_array(llist_t * llist, int * out, size_t cap)
+/* Copies up to cap values of llist into out, in list
+** order. Returns the number of values copied.
+**/
+{
+  llnode_t * cur;
+  size_t n = 0;
+  int exclusive;
+
+  if (llist == NULL || out == NULL)
+    return 0;
+
+  exclusive = _llist_acquire_ordered_read(llist);
+  for (cur = llist_first(llist); cur && n < cap; cur = llist_next(llist, cur))
+    out[n++] = cur->data;
+  _llist_release_ordered_read(llist, exclusive);
+
+  return n;
+}
+
+llist_t *
+llist_from_array(llorder_type_t order, int const * in, size_t n)
+/* Creates a new linked list of the values in in. Values
+** are sorted as an array, if needed, and then linked in
+** a single pass. Returns NULL on error.
+**/
+{
+  llist_t * llist;
+  int32_t * data;
+  size_t i;
+
+  if (in == NULL && n > 0)
+    return NULL;
+
+  llist = llist_create_with_llorder(order);
+  if (llist == NULL || n == 0)
+    return llist;
+
+  data = (int32_t *) malloc(sizeof(int32_t) * n);
+  if (data == NULL)
+  {
+    llist_free(llist);
+    return NULL;
+  }
+
+  for (i = 0; i < n; i++)
+    data[i] = (int32_t)in[i];
+
+  if (_llist_link_values(llist, data, n) != 0)
+  {
+    llist_free(llist);
+    llist = NULL;
+  }
+
+  free(data);
+  return llist;
+}
+
+int
+llist_stats(llist_t * llist, llist_stats_t * stats)
+/* Copies the operation and lock statistics of llist
+** into stats. Returns 0 on success or -1 if the library
+** was built without TSDS_STATS.
+**/
+{
+  if (llist == NULL || stats == NULL)
+    return -1;
+
+#ifdef TSDS_STATS
+  llstats_copy(stats, &llist->stats);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+void
+llist_stats_reset(llist_t * llist)
+/* Zeroes the statistics of llist. Does nothing if the
+** library was built without TSDS_STATS.
+**/
+{
+  if (llist == NULL)
+    return;
+
+  LLSTATS_ONLY(llstats_reset(&llist->stats);)
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */ 
+/*-----------------------------------*/
+
+static void 
+_llist_init(llist_t * llist)
+/* Initializes linked list and sets llorder_type_t to
+** unordered. llist should always be a valid pointer.
+**/
+{
+  llist->head = NULL;
+  llist->tail = NULL;
+  llist->order = NONE;
+  llist->sz = 0;
+  llist->flags = LLIST_DEFAULT;
+  llist->reversed = 0;
+  llist->sorted_as = NONE;
+  llist->sorted_sz = 0;
+  llist->finger = NULL;
+  LLSTATS_ONLY(llstats_reset(&llist->stats);)
+}
+
+static void 
+_llist_init_with_llorder(llist_t * llist, llorder_type_t order)
+/* Initializes linked list and sets llorder_type_t to
+** specified order. llist should always be a valid
+** pointer.
+**/
+{
+  _llist_init(llist);
+  llist->order = order;
+  llist->sorted_as = order;
+}
+
+static int
+_llist_insert_llnode(llist_t * llist, llnode_t * llnode, llnode_t ** kept)
+/* Does the work of llist_insert(...) and stores the llnode
+** that holds llnode's value in kept. This function should
+** not be called if kept is NULL.
+**/
+{
+  llnode_t * existing = NULL;
+
+  /* Avoids unnecessary locking/unlocking 
+     of mutexes */
+  if (llist == NULL)
+  {
+    *kept = NULL;
+    return -1;
+  }
+
+  _llist_lock(llist);
+  if (llist && llnode)
+  {
+    llorder_type_t order = _llist_phys_order(llist);
+    int pending = _llist_order_pending(llist);
+    int unique = llist->flags & LLIST_UNIQUE;
+
+    /* Buffered at the tail until the deferred order
+       change is applied */
+    if (pending || order == NONE)
+    {
+      if (unique)
+        existing = _llist_find_llnode(llist, llnode->data);
+      if (existing == NULL)
+        _llist_insert_unordered(llist, llnode);
+    }
+
+    /* The walk to the insertion point passes any equal
+       llnode, so duplicates cost no extra traversal */
+    else
+    {
+      llnode_t * prev = _llist_get_prev_llnode(llist, order, llnode->data);
+      if (unique && prev && prev->data == llnode->data)
+        existing = prev;
+      else
+        _llist_link_after(llist, prev, llnode);
+    }
+
+    if (existing == NULL)
+    {
+      llist->sz++;
+      llist->finger = llnode;
+      if (!pending && llist->order != NONE)
+        llist->sorted_sz = llist->sz;
+    }
+    LLSTATS_INC(llist, inserts);
+  }
+  _llist_unlock(llist);
+
+  if (existing)
+  {
+    llnode_free(llnode);
+    *kept = existing;
+    return 1;
+  }
+  *kept = llnode;
+  return llnode ? 0 : -1;
+}
+
+static void
+_llist_insert_unordered(llist_t * llist, llnode_t * llnode)
+/* Appends llnode to the logical end of linked list. This
+** function should not be called if llist or llnode are
+** NULL.
+**/
+{
+  if (llist->reversed)
+    _llist_link_after(llist, NULL, llnode);
+  else
+    _llist_link_after(llist, llist->tail, llnode);
+}
+
+static void
+_llist_link_after(llist_t * llist, llnode_t * prev_llnode, llnode_t * llnode)
+/* Links llnode physically after prev_llnode, or as the
+** new HEAD if prev_llnode is NULL. Does not change the
+** size of llist.
+**/
+{
+  llnode_t * next_llnode = prev_llnode ? prev_llnode->next : llist->head;
+
+  llnode->prev = prev_llnode;
+  llnode->next = next_llnode;
+
+  if (prev_llnode)
+    prev_llnode->next = llnode;
+  else
+    llist->head = llnode;
+
+  if (next_llnode)
+    next_llnode->prev = llnode;
+  else
+    llist->tail = llnode;
+}
+
+static void
+_llist_unlink(llist_t * llist, llnode_t * llnode)
+/* Unlinks llnode from llist in constant time. Does not
+** change the size of llist.
+**/
+{
+  if (llist->finger == llnode)
+    llist->finger = llnode->prev;
+
+  if (llnode->prev)
+    llnode->prev->next = llnode->next;
+  else
+    llist->head = llnode->next;
+
+  if (llnode->next)
+    llnode->next->prev = llnode->prev;
+  else
+    llist->tail = llnode->prev;
+
+  llnode->next = NULL;
+  llnode->prev = NULL;
+}
+
+static llorder_type_t
+_llist_phys_order(llist_t const * llist)
+/* Returns the order of the nodes as linked through next.
+** A reversed doubly linked list stores its elements in
+** the opposite of its logical order.
+**/
+{
+  if (!llist->reversed || llist->order == NONE)
+    return llist->order;
+  return (llist->order == ASC) ? DESC : ASC;
+}
+
+static void
+_llist_lock(llist_t * llist)
+/* Acquires exclusive access to llist. Lists created
+** with LLIST_ADAPTIVE_LOCK use their own lock, all
+** others share the global mutexes.
+**/
+{
+  LLSTATS_ONLY(uint64_t start = llstats_now();)
+
+  if (llist->flags & LLIST_ADAPTIVE_LOCK)
+    adlock_acquire(&llist->lock);
+  else
+  {
+    pthread_mutex_lock(&mtx);
+    pthread_mutex_lock(&w_mtx);
+  }
+
+  LLSTATS_ONLY(llist->held_since = llstats_now();)
+  LLSTATS_RECORD(llist, write_wait, llist->held_since - start);
+}
+
+static void
+_llist_unlock(llist_t * llist)
+/* Releases exclusive access acquired by _llist_lock.
+**/
+{
+  LLSTATS_RECORD(llist, write_hold, llstats_now() - llist->held_since);
+
+  if (llist->flags & LLIST_ADAPTIVE_LOCK)
+  {
+    adlock_release(&llist->lock);
+    return;
+  }
+
+  pthread_mutex_unlock(&w_mtx);
+  pthread_mutex_unlock(&mtx);
+}
+
+static void
+_llist_acquire_writers_lock(llist_t * llist)
+/* The first thread to call this function acquires
+** a lock on writers' mutex w_mtx and sets itself
+** as the first reader in the reader structure.
+** Lists with an adaptive lock take it exclusively
+** since their critical sections are short.
+**/
+{
+  LLSTATS_ONLY(uint64_t start = llstats_now();)
+
+  if (llist->flags & LLIST_ADAPTIVE_LOCK)
+    adlock_acquire(&llist->lock);
+  else
+  {
+    pthread_mutex_lock(&mtx);
+    pthread_mutex_lock(&reader.mtx);
+    /* First reader locks writer mutex */
+    if (!reader.entered)
+    {
+      reader.entered = 1;
+      reader.first_reader = pthread_self();
+      pthread_mutex_lock(&w_mtx);
+    }
+    reader.cnt++;
+    pthread_mutex_unlock(&reader.mtx);
+    pthread_mutex_unlock(&mtx);
+  }
+
+  LLSTATS_ONLY(read_since = llstats_now();)
+  LLSTATS_RECORD(llist, read_wait, read_since - start);
+}
+
+static void
+_llist_release_writers_lock(llist_t * llist)
+/* The second to last reader signals the first reader,
+** which acquired lock on w_mtx, to release lock on
+** w_mtx.
+**/
+{
+  LLSTATS_RECORD(llist, read_hold, llstats_now() - read_since);
+
+  if (llist->flags & LLIST_ADAPTIVE_LOCK)
+  {
+    adlock_release(&llist->lock);
+    return;
+  }
+
+  // DEBUG
+  if (DEBUG)
+    puts("_llist_release_writers_lock(llist_t * llist)");
+
+  /* First reader releases writer mutex */
+  pthread_mutex_lock(&reader.mtx);
+  if (reader.first_reader == pthread_self())
+  {
+    LLSTATS_ONLY(uint64_t start = llstats_now();)
+    while (reader.cnt != 1)
+      pthread_cond_wait(&reader.cv, &reader.mtx);
+    LLSTATS_RECORD(llist, handoff_wait, llstats_now() - start);
+
+    /* Only thread that locked w_mtx can unlock it */
+    pthread_mutex_unlock(&w_mtx); 
+
+    reader.cnt--;
+    reader.entered = 0; /* No readers reading */
+  }
+  else
+  {
+    if (--reader.cnt == 1)
+      pthread_cond_signal(&reader.cv);
+  }
+  pthread_mutex_unlock(&reader.mtx);
+}
+
+static void
+_llist_reverse(llist_t * llist)
+/* Reverses the physical order of llist by swapping the
+** links of every llnode.
+**/
+{
+  llnode_t * next;
+  llnode_t * cur;
+
+  cur = llist->head;
+  llist->head = llist->tail;
+  llist->tail = cur;
+
+  while (cur)
+  {
+    next = cur->next;
+    cur->next = cur->prev;
+    cur->prev = next;
+    cur = next;
+  }
+}
+
+static void
+_llist_reorder_llnodes_in_llist(llist_t * llist, llnode_t * llnodes[])
+/* Size of llnodes should always be equal to llist size.
+**/
+{
+  size_t sz = llist->sz;
+  llist->head = llnodes[0];
+  llist->head->prev = NULL;
+  llnode_t * cur = llist->head;
+  size_t i;
+  for (i = 1; i < sz && cur; i++)
+  {
+    cur->next = llnodes[i];
+    llnodes[i]->prev = cur;
+    cur = llnodes[i];
+  }
+  llist->tail = cur;
+  llist->tail->next = NULL;
+}
+
+static void
+_llist_sort(llist_t * llist, llorder_type_t order)
+/* Sorts llist in the order specified by order. Uses
+** qsort and ascending/descending comparitors to sort.
+** Does not modify the order of the llist itself.
+**/
+{
+  // DEBUG
+  if (DEBUG)
     puts("_llist_sort(llist_t * llist, llorder_type_t order)");
 
+  /* Nodes are relinked in order, so the list is no
+     longer stored reversed */
+  llist->reversed = 0;
+  llist->sorted_as = order;
+  llist->sorted_sz = llist->sz;
+
   if (llist->sz == 0)
     return;
 
-  llnode_t ** llnodes = _llist_make_llnode_array(llist);
+  llnode_t ** llnodes = _llist_make_llnode_array(llist);
+
+  if (order == ASC)
+    qsort(llnodes, llist->sz, sizeof(llnode_t *), _llist_asc_comparitor);
+  else if (order == DESC)
+    qsort(llnodes, llist->sz, sizeof(llnode_t *), _llist_desc_comparitor);
+
+  _llist_reorder_llnodes_in_llist(llist, llnodes);
+  free(llnodes);
+}
+
+static int
+_llist_order_pending(llist_t const * llist)
+/* Returns 1 if llist has a deferred order change or
+** buffered inserts that have not been sorted in yet.
+**/
+{
+  return (llist->flags & LLIST_LAZY_SORT)
+         && llist->order != NONE
+         && (llist->sorted_as != llist->order
+             || llist->sorted_sz != llist->sz);
+}
+
+static void
+_llist_apply_order(llist_t * llist)
+/* Brings a lazy list into its recorded order. The first
+** sorted_sz nodes are already sorted as sorted_as, so
+** only the buffered tail is sorted and then merged with
+** the (possibly reversed) sorted prefix.
+**/
+{
+  llnode_t ** buffered;
+  llnode_t * cut;
+  llnode_t * prefix;
+  llnode_t * tail;
+  size_t i, num_buffered;
+  int (*cmp)(void const *, void const *);
+
+  if (!_llist_order_pending(llist))
+    return;
+
+  LLSTATS_INC(llist, sorts);
+
+  if (llist->sorted_as == NONE || llist->sorted_sz == 0)
+  {
+    _llist_sort(llist, llist->order);
+    return;
+  }
+
+  if (llist->sorted_sz == llist->sz)
+  {
+    _llist_reverse(llist);
+    llist->sorted_as = llist->order;
+    return;
+  }
+
+  /* Detaches the buffered tail */
+  num_buffered = llist->sz - llist->sorted_sz;
+  buffered = (llnode_t **) malloc(sizeof(llnode_t *) * num_buffered);
+  if (buffered == NULL)
+  {
+    _llist_sort(llist, llist->order);
+    return;
+  }
+
+  cut = _llist_get_llnode_at(llist, llist->sorted_sz);
+  for (i = 0; i < num_buffered; i++, cut = cut->next)
+    buffered[i] = cut;
+
+  tail = buffered[0]->prev;
+  tail->next = NULL;
+  llist->tail = tail;
+
+  if (llist->sorted_as != llist->order)
+    _llist_reverse(llist);
+
+  cmp = (llist->order == ASC) ? _llist_asc_comparitor : _llist_desc_comparitor;
+  qsort(buffered, num_buffered, sizeof(llnode_t *), cmp);
+
+  /* Merges prefix and buffered nodes, prefix first on ties */
+  prefix = llist->head;
+  llist->head = llist->tail = NULL;
+  i = 0;
+  while (prefix || i < num_buffered)
+  {
+    llnode_t * next;
+    if (prefix
+        && (i == num_buffered || cmp(&prefix, &buffered[i]) <= 0))
+    {
+      next = prefix;
+      prefix = prefix->next;
+    }
+    else
+      next = buffered[i++];
+
+    next->prev = llist->tail;
+    next->next = NULL;
+    if (llist->tail)
+      llist->tail->next = next;
+    else
+      llist->head = next;
+    llist->tail = next;
+  }
+
+  free(buffered);
+  llist->sorted_as = llist->order;
+  llist->sorted_sz = llist->sz;
+}
+
+static int
+_llist_acquire_ordered_read(llist_t * llist)
+/* Acquires the read lock for a read that depends on the
+** order of llist. If a deferred order change has to be
+** applied first, the write lock is taken instead and 1
+** is returned.
+**/
+{
+  _llist_acquire_writers_lock(llist);
+  if (!_llist_order_pending(llist))
+    return 0;
+  _llist_release_writers_lock(llist);
+
+  _llist_lock(llist);
+  _llist_apply_order(llist);
+  return 1;
+}
+
+static void
+_llist_release_ordered_read(llist_t * llist, int exclusive)
+{
+  if (exclusive)
+    _llist_unlock(llist);
+  else
+    _llist_release_writers_lock(llist);
+}
 
-  if (order == ASC)
-    qsort(llnodes, llist->sz, sizeof(llnode_t *), _llist_asc_comparitor);
-  else if (order == DESC)
-    qsort(llnodes, llist->sz, sizeof(llnode_t *), _llist_desc_comparitor);
+static int
+_llist_int32_asc_comparitor(void const * lhs, void const * rhs)
+{
+  int32_t l = *(int32_t const *)lhs;
+  int32_t r = *(int32_t const *)rhs;
+  return (l > r) - (l < r);
+}
 
-  _llist_reorder_llnodes_in_llist(llist, llnodes);
-  free(llnodes);
+static int
+_llist_int32_desc_comparitor(void const * lhs, void const * rhs)
+{
+  return _llist_int32_asc_comparitor(rhs, lhs);
 }
 
 static int
@@ -541,7 +1481,7 @@ _llist_asc_comparitor(void const * lhs, void const * rhs)
 {
   llnode_t * l_lhs = *((llnode_t **)lhs);
   llnode_t * l_rhs = *((llnode_t **)rhs);
-  return l_lhs->data - l_rhs->data;
+  return (l_lhs->data > l_rhs->data) - (l_lhs->data < l_rhs->data);
 }
 
 static int
@@ -549,94 +1489,154 @@ _llist_desc_comparitor(void const * lhs, void const * rhs)
 {
   llnode_t * l_lhs = *((llnode_t **)lhs);
   llnode_t * l_rhs = *((llnode_t **)rhs);
-  return l_rhs->data - l_lhs->data;
+  return (l_rhs->data > l_lhs->data) - (l_rhs->data < l_lhs->data);
+}
+
+static llnode_t *
+_llist_find_llnode(llist_t * llist, int data)
+/* Returns an llnode containing data or NULL. Sorted lists
+** are searched like an insert of data, other lists are
+** scanned in full. Only reads llist.
+**/
+{
+  llorder_type_t order = _llist_phys_order(llist);
+  llnode_t * llnode;
+
+  if (order != NONE && !_llist_order_pending(llist))
+  {
+    llnode = _llist_get_prev_llnode(llist, order, data);
+    return llnode && llnode->data == data ? llnode : NULL;
+  }
+
+  for (llnode = llist_first(llist); llnode; llnode = llist_next(llist, llnode))
+    if (llnode->data == data)
+      return llnode;
+  return NULL;
+}
+
+static int
+_llist_precedes(llorder_type_t order, int lhs, int rhs)
+/* Returns 1 if a llnode containing lhs is linked before
+** a new llnode containing rhs in a list linked in order.
+**/
+{
+  return order == ASC ? lhs <= rhs : lhs >= rhs;
 }
 
 static llnode_t *
-_llist_get_prev_llnode(llist_t * llist, int data)
+_llist_get_prev_llnode(llist_t * llist, llorder_type_t order, int data)
 /* Returns the llnode that comes before llnode containing 
-** data. If llnode with data doesn't exist or llnode
-** containing data is HEAD llnode, it returns NULL.
+** data when llist is linked in order. If llnode with data
+** doesn't exist or llnode containing data is HEAD llnode,
+** it returns NULL. For ASC and DESC, appends at either
+** end are found in constant time and other searches
+** start at the last inserted llnode (the finger), so
+** nearly sorted input only walks a few llnodes.
 **/
 {
   llnode_t * res = NULL;
   llnode_t * head = llist->head;
+  LLSTATS_ONLY(uint64_t steps = 0;)
   if (head)
   {
-    if (llist->order == ASC &&
-        head->data <= data)
-    {
-      res = head;
-      while (res->next && res->next->data <= data)
-        res = res->next;
-    }
-    else if (llist->order == DESC &&
-             head->data >= data)
+    if (order == ASC || order == DESC)
     {
-      res = head;
-      while (res->next && res->next->data >= data)
-        res = res->next;
+      llnode_t * tail = llist->tail;
+      llnode_t * finger = llist->finger;
+
+      if (_llist_precedes(order, tail->data, data))
+        res = tail;
+
+      else if (!_llist_precedes(order, head->data, data))
+        res = NULL;
+
+      /* Walks forward from the finger if data goes after
+         it, otherwise backward to the last llnode that
+         does not go after data */
+      else if (finger && !_llist_precedes(order, finger->data, data))
+      {
+        res = finger->prev;
+        while (!_llist_precedes(order, res->data, data))
+        {
+          res = res->prev;
+          LLSTATS_ONLY(steps++;)
+        }
+      }
+      else
+      {
+        res = finger ? finger : head;
+        while (res->next && _llist_precedes(order, res->next->data, data))
+        {
+          res = res->next;
+          LLSTATS_ONLY(steps++;)
+        }
+      }
     }
-    else if (llist->order == NONE &&
+    else if (order == NONE &&
              head->data != data)
     {
       res = head;
       while (res->next && res->next->data != data)
+      {
         res = res->next;
+        LLSTATS_ONLY(steps++;)
+      }
     }
   }
 
+  LLSTATS_RECORD(llist, traversal, steps);
   return res;
 }
 
 static llnode_t *
-_llist_extract_llnode(llist_t * llist, int data)
-/* Extracts llnode containing data from linked list
-** and modifies previous llnode to point to extracted
-** llnode's next llnode.
+_llist_extract_llnode(llist_t * llist, int data, size_t * pos)
+/* Extracts the logically first llnode containing data
+** from linked list and relinks its neighbours. Stores
+** the position the llnode was found at in pos.
 **/
 {
-  llnode_t * prev_llnode = llist->head;
-
-  if (llist->head == NULL)
-    return NULL;
+  llnode_t * llnode = llist_first(llist);
 
-  /* Handles case where llnode to extract is HEAD */
-  if (llist->head->data == data)
+  *pos = 0;
+  while (llnode && llnode->data != data)
   {
-    if (llist->sz == 1)
-      llist->head = llist->tail = NULL;
-
-    else
-      llist->head = llist->head->next;
-
-    return prev_llnode;
+    llnode = llist_next(llist, llnode);
+    (*pos)++;
   }
+  LLSTATS_RECORD(llist, traversal, *pos);
 
-  while (prev_llnode->next && prev_llnode->next->data != data)
-    prev_llnode = prev_llnode->next;
-
-  llnode_t * extracted_llnode = prev_llnode->next;
-  if (prev_llnode->next && prev_llnode->next->data == data)
-    prev_llnode->next = prev_llnode->next->next;
-
-  /* Handles case where llnode to extract is TAIL */
-  if (extracted_llnode == llist->tail)
-    llist->tail = prev_llnode;
+  if (llnode)
+    _llist_unlink(llist, llnode);
 
-  return extracted_llnode;
+  return llnode;
 }
 
 static llnode_t *
 _llist_get_llnode_at(llist_t * llist, size_t idx)
-/* Returns node at position idx if it exists or
-** returns NULL otherwise.
+/* Returns node at physical position idx if it exists or
+** returns NULL otherwise. Walks from whichever end of
+** llist is closer to idx.
 **/
 {
   size_t i = 0;
-  llnode_t * cur = llist->head;
-  while (cur && i++ < idx)
-    cur = cur->next;
+  llnode_t * cur;
+
+  if (idx >= llist->sz)
+    return NULL;
+
+  if (idx <= llist->sz / 2)
+  {
+    cur = llist->head;
+    while (cur && i++ < idx)
+      cur = cur->next;
+  }
+  else
+  {
+    cur = llist->tail;
+    while (cur && i++ < llist->sz - 1 - idx)
+      cur = cur->prev;
+  }
+  LLSTATS_RECORD(llist, traversal, i);
   return cur;
 }
 
@@ -657,3 +1657,488 @@ _llist_make_llnode_array(llist_t * llist)
   }
   return llnodes;
 }
+
+static llnode_t *
+_llist_range_seek(llist_t const * llist, int lo)
+/* Returns the first llnode of an ascending walk over
+** llist that may hold a value >= lo. Ordered lists skip
+** smaller values, unordered lists start at the first
+** llnode.
+**/
+{
+  llnode_t * llnode;
+
+  if (llist->order == DESC)
+    llnode = llist_last(llist);
+  else
+    llnode = llist_first(llist);
+
+  if (llist->order != NONE)
+    while (llnode && llnode->data < lo)
+      llnode = _llist_range_next(llist, llnode);
+
+  return llnode;
+}
+
+static llnode_t *
+_llist_range_next(llist_t const * llist, llnode_t const * llnode)
+/* Steps an ascending walk started by _llist_range_seek.
+** DESC lists are walked from their logical end.
+**/
+{
+  if (llist->order == DESC)
+    return llist_prev(llist, llnode);
+  return llist_next(llist, llnode);
+}
+
+static size_t
+_llist_range_walk(llist_t * llist,
+                  int lo,
+                  int hi,
+                  int * out,
+                  size_t cap,
+                  int64_t * sum)
+/* Visits up to cap elements in [lo, hi] under a single
+** read lock, copying them into out and adding them to
+** sum when those are not NULL. Ordered lists stop at the
+** first value above hi. Returns the number visited.
+**/
+{
+  llnode_t * llnode;
+  size_t n = 0;
+  int exclusive;
+
+  if (llist == NULL || lo > hi)
+    return 0;
+
+  exclusive = _llist_acquire_ordered_read(llist);
+  for (llnode = _llist_range_seek(llist, lo);
+       llnode && n < cap;
+       llnode = _llist_range_next(llist, llnode))
+  {
+    if (llnode->data > hi)
+    {
+      if (llist->order != NONE)
+        break;
+      continue;
+    }
+    if (llnode->data < lo)
+      continue;
+
+    if (out)
+      out[n] = llnode->data;
+    if (sum)
+      *sum += llnode->data;
+    n++;
+  }
+  _llist_release_ordered_read(llist, exclusive);
+
+  return n;
+}
+
+static llnode_t *
+_llist_extremum(llist_t * llist, int max)
+/* Returns the llnode holding the smallest element of
+** llist, or the largest if max is set.
+**/
+{
+  llnode_t * res;
+  llnode_t * llnode;
+  int exclusive;
+
+  if (llist == NULL)
+    return NULL;
+
+  exclusive = _llist_acquire_ordered_read(llist);
+  if (llist->order == NONE)
+  {
+    res = llist_first(llist);
+    for (llnode = res; llnode; llnode = llist_next(llist, llnode))
+      if (max ? llnode->data > res->data : llnode->data < res->data)
+        res = llnode;
+  }
+  else if ((llist->order == ASC) == !max)
+    res = llist_first(llist);
+  else
+    res = llist_last(llist);
+  _llist_release_ordered_read(llist, exclusive);
+
+  return res;
+}
+
+static void
+_llist_lock_pair(llist_t * a, llist_t * b)
+/* Acquires exclusive access to two lists. The global
+** mutexes are always taken before any adaptive lock and
+** adaptive locks in address order, so concurrent pairs
+** cannot deadlock. Shared locks are only taken once.
+**/
+{
+  llist_t * first = a;
+  llist_t * second = b;
+
+  if (a == b
+      || !((a->flags | b->flags) & LLIST_ADAPTIVE_LOCK))
+  {
+    _llist_lock(a);
+    return;
+  }
+
+  if ((a->flags & LLIST_ADAPTIVE_LOCK)
+      && (!(b->flags & LLIST_ADAPTIVE_LOCK) || (uintptr_t)b < (uintptr_t)a))
+  {
+    first = b;
+    second = a;
+  }
+
+  _llist_lock(first);
+  _llist_lock(second);
+}
+
+static void
+_llist_unlock_pair(llist_t * a, llist_t * b)
+/* Releases the locks taken by _llist_lock_pair.
+**/
+{
+  if (a == b
+      || !((a->flags | b->flags) & LLIST_ADAPTIVE_LOCK))
+  {
+    _llist_unlock(a);
+    return;
+  }
+
+  _llist_unlock(a);
+  _llist_unlock(b);
+}
+
+static int
+_llist_set_take(llist_t * res, llist_t * src, llnode_t * llnode, llset_mode_t mode)
+/* Appends llnode, or a copy of it, to the end of res.
+** Returns -1 if the copy could not be allocated.
+**/
+{
+  if (mode == LLIST_SET_MOVE)
+  {
+    _llist_unlink(src, llnode);
+    src->sz--;
+    src->sorted_sz = src->sz;
+  }
+  else if ((llnode = llnode_create(llnode->data)) == NULL)
+    return -1;
+
+  _llist_link_after(res, res->tail, llnode);
+  res->sz++;
+  return 0;
+}
+
+static llist_t *
+_llist_set_op(llist_t * a, llist_t * b, llset_op_t op, llset_mode_t mode)
+/* Merges a and b in a single pass, walking both from
+** their smallest element. Runs that cannot contribute
+** are skipped without allocating, and intersections
+** stop as soon as either list is exhausted.
+**/
+{
+  llist_t * res;
+  llnode_t * na;
+  llnode_t * nb;
+  llnode_t * next;
+  int err = 0;
+
+  if (a == NULL || b == NULL)
+    return NULL;
+
+  /* Moving llnodes out of a list while merging it with
+     itself would skip llnodes */
+  if (a == b)
+    mode = LLIST_SET_COPY;
+
+  _llist_lock_pair(a, b);
+  _llist_apply_order(a);
+  _llist_apply_order(b);
+
+  if (a->order == NONE
+      || b->order == NONE
+      || (res = llist_create_with_llorder(a->order)) == NULL)
+  {
+    _llist_unlock_pair(a, b);
+    return NULL;
+  }
+
+  na = _llist_range_seek(a, INT_MIN);
+  nb = _llist_range_seek(b, INT_MIN);
+  while (na && nb && !err)
+  {
+    if (na->data < nb->data)
+    {
+      next = _llist_range_next(a, na);
+      if (op != LLSET_INTERSECT)
+        err = _llist_set_take(res, a, na, mode);
+      na = next;
+    }
+    else if (nb->data < na->data)
+    {
+      next = _llist_range_next(b, nb);
+      if (op == LLSET_UNION)
+        err = _llist_set_take(res, b, nb, mode);
+      nb = next;
+    }
+    else
+    {
+      next = _llist_range_next(a, na);
+      nb = _llist_range_next(b, nb);
+      if (op != LLSET_DIFFERENCE)
+        err = _llist_set_take(res, a, na, mode);
+      na = next;
+    }
+  }
+
+  /* Remaining llnodes have no counterpart */
+  if (op != LLSET_INTERSECT)
+    for (; na && !err; na = next)
+    {
+      next = _llist_range_next(a, na);
+      err = _llist_set_take(res, a, na, mode);
+    }
+
+  if (op == LLSET_UNION)
+    for (; nb && !err; nb = next)
+    {
+      next = _llist_range_next(b, nb);
+      err = _llist_set_take(res, b, nb, mode);
+    }
+
+  _llist_unlock_pair(a, b);
+
+  if (err)
+  {
+    llist_free(res);
+    return NULL;
+  }
+
+  /* Built ascending */
+  if (res->order == DESC)
+    _llist_reverse(res);
+  res->sorted_sz = res->sz;
+  return res;
+}
+
+static void
+_llist_make_ascending(llist_t * llist)
+/* Relinks an ordered llist so that it is physically
+** ascending and not stored reversed. Does not change
+** the order of llist.
+**/
+{
+  if (_llist_phys_order(llist) == DESC)
+    _llist_reverse(llist);
+  llist->reversed = 0;
+}
+
+static void
+_llist_cut(llist_t * llist, llist_t * res, size_t idx, int take_prefix)
+/* Splits the logical sequence of llist before position
+** idx and moves either the prefix or the suffix into the
+** empty list res, which takes the order of llist.
+**/
+{
+  size_t phys_cut = llist->reversed ? llist->sz - idx : idx;
+  llnode_t * cut = _llist_get_llnode_at(llist, phys_cut);
+  llnode_t * before = cut ? cut->prev : llist->tail;
+
+  /* A reversed list stores its logical prefix at the
+     physical back */
+  if (take_prefix == llist->reversed)
+  {
+    res->head = cut;
+    res->tail = cut ? llist->tail : NULL;
+    res->sz = llist->sz - phys_cut;
+    llist->tail = before;
+    llist->sz = phys_cut;
+  }
+  else
+  {
+    res->head = before ? llist->head : NULL;
+    res->tail = before;
+    res->sz = phys_cut;
+    llist->head = cut;
+    llist->sz -= phys_cut;
+  }
+
+  if (before)
+    before->next = NULL;
+  else if (res->head == cut)
+    llist->head = NULL;
+  if (cut)
+    cut->prev = NULL;
+  else if (res->tail == before)
+    llist->tail = NULL;
+
+  res->order = llist->order;
+  res->reversed = llist->reversed;
+  res->sorted_as = llist->order;
+  res->sorted_sz = llist->order == NONE ? 0 : res->sz;
+  llist->sorted_sz = llist->order == NONE ? 0 : llist->sz;
+  llist->finger = NULL;
+}
+
+static int
+_llist_link_values(llist_t * llist, int32_t * data, size_t sz)
+/* Links llnodes for the sz values of data onto the empty
+** llist. data is sorted in place first if it does not
+** match the order of llist. Returns 0 on success or -1
+** if an llnode could not be allocated.
+**/
+{
+  llnode_t * prev = NULL;
+  size_t i;
+
+  if (!_llist_is_sorted(data, sz, llist->order))
+    qsort(data, sz, sizeof(int32_t),
+          llist->order == ASC ? _llist_int32_asc_comparitor
+                              : _llist_int32_desc_comparitor);
+
+  /* Bulk link, no per-element ordering work */
+  for (i = 0; i < sz; i++)
+  {
+    llnode_t * llnode = llnode_create(data[i]);
+    if (llnode == NULL)
+      return -1;
+
+    if (prev)
+      prev->next = llnode;
+    else
+      llist->head = llnode;
+    llnode->prev = prev;
+    prev = llnode;
+    llist->tail = llnode;
+    llist->sz++;
+  }
+
+  if (llist->order != NONE)
+    llist->sorted_sz = llist->sz;
+  return 0;
+}
+
+static int
+_llist_write_values(llist_t * llist, int fd, lldump_format_t format)
+/* Writes the values of llist to fd in list order through
+** a single buffer. Must be called with llist locked.
+** Returns 0 on success or -1 on error.
+**/
+{
+  /* Flushed once less than one formatted value fits */
+  char * buf;
+  size_t cap = LLSNAP_CHUNK * 16;
+  size_t len = 0;
+  llnode_t * cur;
+  int ret = 0;
+
+  buf = (char *) malloc(cap);
+  if (buf == NULL)
+    return -1;
+
+  for (cur = llist_first(llist); ret == 0 && cur; cur = llist_next(llist, cur))
+  {
+    if (format == LLIST_DUMP_BINARY)
+    {
+      int32_t value = (int32_t)cur->data;
+      memcpy(buf + len, &value, sizeof(value));
+      len += sizeof(value);
+    }
+    else
+    {
+      len += _llist_format_int(buf + len, cur->data);
+      buf[len++] = '\n';
+    }
+
+    if (cap - len < 16)
+    {
+      ret = llio_write_all(fd, buf, len);
+      len = 0;
+    }
+  }
+
+  if (ret == 0 && len > 0)
+    ret = llio_write_all(fd, buf, len);
+
+  free(buf);
+  return ret;
+}
+
+static size_t
+_llist_format_int(char * buf, int value)
+/* Writes value to buf in decimal without a terminating
+** NUL and returns its length, at most 11 characters.
+**/
+{
+  char digits[10];
+  unsigned int u = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+  size_t n = 0;
+  size_t len = 0;
+
+  do
+  {
+    digits[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+
+  if (value < 0)
+    buf[len++] = '-';
+  while (n)
+    buf[len++] = digits[--n];
+  return len;
+}
+
+int
+llio_write_all(int fd, void const * buf, size_t len)
+/* Writes len bytes of buf to fd, retrying partial and
+** interrupted writes. Returns 0 on success or -1.
+**/
+{
+  char const * cur = (char const *)buf;
+  while (len > 0)
+  {
+    ssize_t n = write(fd, cur, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    cur += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int
+_llist_read_all(int fd, void * buf, size_t len)
+/* Reads exactly len bytes from fd into buf. Returns 0
+** on success or -1 on error or early end of file.
+**/
+{
+  char * cur = (char *)buf;
+  while (len > 0)
+  {
+    ssize_t n = read(fd, cur, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    cur += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int
+_llist_is_sorted(int32_t const * data, size_t sz, llorder_type_t order)
+{
+  size_t i;
+  for (i = 1; i < sz; i++)
+  {
+    if ((order == ASC && data[i - 1] > data[i])
+        || (order == DESC && data[i - 1] < data[i]))
+      return 0;
+  }
+  return 1;
+}
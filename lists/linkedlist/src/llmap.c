@@ -0,0 +1,477 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../headers/llmap.h"
+#include "../headers/llio.h"
+
+/* File layout: an llmap_header_t followed by node_count
+** llmap_node_t records. Offsets are bytes from the start
+** of the file and 0 means no node. All fields use the
+** byte order of the machine that wrote them. */
+#define LLMAP_MAGIC   "TSDM"
+#define LLMAP_VERSION 1
+#define LLMAP_CHUNK   4096  /* Records buffered per write */
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t order;
+  uint32_t reserved;
+  uint64_t sz;
+  uint64_t head;
+  uint64_t node_count;
+} llmap_header_t;
+
+typedef struct
+{
+  int32_t data;
+  uint32_t reserved;
+  uint64_t next;
+} llmap_node_t;
+
+/* Produces the values to be written one at a time,
+** returns 0 once there are none left */
+typedef int (*llmap_source_t)(void *, int *);
+
+typedef struct
+{
+  llist_t * llist;
+  llnode_t * llnode;
+} llmap_llist_cursor_t;
+
+/*-----------------------------------*/
+/* Helper Functions Declarations     */
+/*-----------------------------------*/
+static llmap_node_t * _llmap_node(llmap_t *, uint64_t);
+static llmap_node_t * _llmap_chain(llmap_t *, uint64_t, uint64_t);
+static int _llmap_before(llorder_type_t, int, int);
+static int _llmap_write(char const *, llorder_type_t, size_t, llmap_source_t, void *);
+static int _llmap_llist_source(void *, int *);
+static int _llmap_iter_source(void *, int *);
+
+/*-----------------------------------*/
+/* Function Definitions              */
+/*-----------------------------------*/
+
+int
+llmap_write(llist_t * llist, char const * path)
+/* Writes llist to path in the mapped list format.
+** Returns 0 on success or -1 on error. Like print, it
+** walks llist directly and must not race with writers.
+**/
+{
+  llmap_llist_cursor_t cursor;
+
+  if (llist == NULL || path == NULL)
+    return -1;
+
+  llist_apply_order(llist);
+
+  cursor.llist = llist;
+  cursor.llnode = llist_first(llist);
+  return _llmap_write(path, llist->order, llist->sz,
+                      _llmap_llist_source, &cursor);
+}
+
+llmap_t *
+llmap_open(char const * path)
+/* Maps the list stored at path. Only the header is
+** validated, so opening takes constant time regardless
+** of the list size. Walks of the mapped nodes stop after
+** the header's node count, so a file whose offsets loop
+** fails the operation instead of hanging it. Returns NULL
+** on error.
+**/
+{
+  llmap_header_t const * header;
+  llmap_t * map;
+  struct stat st;
+  int fd;
+
+  if (path == NULL)
+    return NULL;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) != 0
+      || (size_t)st.st_size < sizeof(llmap_header_t))
+  {
+    close(fd);
+    return NULL;
+  }
+
+  map = (llmap_t *) malloc(sizeof(llmap_t));
+  if (map == NULL)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  map->len = (size_t)st.st_size;
+  map->base = (char *) mmap(NULL, map->len, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map->base == MAP_FAILED)
+  {
+    free(map);
+    return NULL;
+  }
+
+  header = (llmap_header_t const *)map->base;
+  if (memcmp(header->magic, LLMAP_MAGIC, sizeof(header->magic)) != 0
+      || header->version != LLMAP_VERSION
+      || header->order > NONE
+      || header->node_count > (map->len - sizeof(llmap_header_t)) / sizeof(llmap_node_t)
+      || header->sz > header->node_count)
+  {
+    munmap(map->base, map->len);
+    free(map);
+    return NULL;
+  }
+
+  map->head = header->head;
+  map->node_count = header->node_count;
+  map->order = (llorder_type_t)header->order;
+  map->sz = (size_t)header->sz;
+  map->overlay = llist_create_with_llorder(map->order);
+  pthread_rwlock_init(&map->rwlock, NULL);
+  return map;
+}
+
+void
+llmap_close(llmap_t * map)
+/* Unmaps map and frees its overlay. Changes that were
+** not written out with llmap_compact are lost.
+**/
+{
+  if (map == NULL)
+    return;
+
+  munmap(map->base, map->len);
+  llist_free(map->overlay);
+  pthread_rwlock_destroy(&map->rwlock);
+  free(map);
+}
+
+int
+llmap_compact(llmap_t * map, char const * path)
+/* Writes the mapped values merged with the overlay to a
+** new file at path. path must not be the file map was
+** opened from. Returns 0 on success or -1 on error.
+**/
+{
+  llmap_iter_t it;
+  int ret;
+
+  if (map == NULL || path == NULL)
+    return -1;
+
+  llmap_iter_begin(map, &it);
+  ret = _llmap_write(path, map->order, map->sz, _llmap_iter_source, &it);
+  llmap_iter_end(&it);
+  return ret;
+}
+
+int
+llmap_contains(llmap_t * map, int data)
+/* Returns 1 if map holds data or 0 otherwise. Ordered
+** maps stop scanning once data can no longer appear.
+**/
+{
+  llmap_node_t * node;
+  llnode_t * llnode;
+  uint64_t i = 0;
+  int found = 0;
+
+  if (map == NULL)
+    return 0;
+
+  pthread_rwlock_rdlock(&map->rwlock);
+
+  node = _llmap_chain(map, map->head, i);
+  while (node && _llmap_before(map->order, node->data, data))
+    node = _llmap_chain(map, node->next, ++i);
+  found = node && node->data == data;
+
+  /* Overlay is only modified under the write lock */
+  for (llnode = map->overlay->head;
+       !found && llnode && _llmap_before(map->order, llnode->data, data);
+       llnode = llnode->next)
+    ;
+  found = found || (llnode && llnode->data == data);
+
+  pthread_rwlock_unlock(&map->rwlock);
+  return found;
+}
+
+int
+llmap_at(llmap_t * map, size_t idx, int * data)
+/* Stores the value at position idx in data. Returns 0
+** on success or -1 if idx is out of bounds.
+**/
+{
+  llmap_iter_t it;
+  int ret = -1;
+  size_t i;
+
+  if (map == NULL || data == NULL)
+    return -1;
+
+  llmap_iter_begin(map, &it);
+  if (idx < map->sz)
+  {
+    for (i = 0; i <= idx && llmap_iter_next(&it, data); i++)
+      ;
+    ret = (i == idx + 1) ? 0 : -1;
+  }
+  llmap_iter_end(&it);
+  return ret;
+}
+
+void
+llmap_insert(llmap_t * map, int data)
+/* Adds data to the overlay of map.
+**/
+{
+  llnode_t * llnode;
+
+  if (map == NULL)
+    return;
+
+  llnode = llnode_create(data);
+  if (llnode == NULL)
+    return;
+
+  pthread_rwlock_wrlock(&map->rwlock);
+  llist_insert(map->overlay, llnode);
+  map->sz++;
+  pthread_rwlock_unlock(&map->rwlock);
+}
+
+int
+llmap_delete(llmap_t * map, int data)
+/* Removes one occurrence of data from map, preferring
+** the overlay. Mapped nodes are unlinked in the private
+** mapping only. Returns 0 if a value was removed or -1.
+**/
+{
+  llmap_node_t * prev;
+  llmap_node_t * node;
+  uint64_t i;
+  int ret = -1;
+
+  if (map == NULL)
+    return -1;
+
+  pthread_rwlock_wrlock(&map->rwlock);
+
+  if (llist_get(map->overlay, data))
+  {
+    llist_delete(map->overlay, data);
+    ret = 0;
+  }
+  else
+  {
+    prev = NULL;
+    i = 0;
+    node = _llmap_chain(map, map->head, i);
+    while (node && node->data != data
+           && (map->order == NONE || _llmap_before(map->order, node->data, data)))
+    {
+      prev = node;
+      node = _llmap_chain(map, node->next, ++i);
+    }
+
+    if (node && node->data == data)
+    {
+      if (prev)
+        prev->next = node->next;
+      else
+        map->head = node->next;
+      ret = 0;
+    }
+  }
+
+  if (ret == 0)
+    map->sz--;
+
+  pthread_rwlock_unlock(&map->rwlock);
+  return ret;
+}
+
+void
+llmap_iter_begin(llmap_t * map, llmap_iter_t * it)
+/* Starts an iteration over map in list order. The map is
+** read locked until llmap_iter_end is called.
+**/
+{
+  pthread_rwlock_rdlock(&map->rwlock);
+  it->map = map;
+  it->off = map->head;
+  it->steps = 0;
+  it->llnode = map->overlay->head;
+}
+
+int
+llmap_iter_next(llmap_iter_t * it, int * data)
+/* Stores the next value in data and returns 1, or
+** returns 0 once the iteration is complete. Ordered maps
+** merge mapped and overlay values, unordered maps yield
+** the overlay after all mapped values. Also returns 0 for
+** good once the mapped nodes turn out to loop.
+**/
+{
+  llmap_node_t * node = _llmap_chain(it->map, it->off, it->steps);
+
+  if (node == NULL && it->steps >= it->map->node_count
+      && _llmap_node(it->map, it->off))
+    return 0;
+
+  if (node
+      && (it->llnode == NULL
+          || it->map->order == NONE
+          || !_llmap_before(it->map->order, it->llnode->data, node->data)))
+  {
+    *data = node->data;
+    it->off = node->next;
+    it->steps++;
+    return 1;
+  }
+
+  if (it->llnode)
+  {
+    *data = it->llnode->data;
+    it->llnode = it->llnode->next;
+    return 1;
+  }
+  return 0;
+}
+
+void
+llmap_iter_end(llmap_iter_t * it)
+{
+  pthread_rwlock_unlock(&it->map->rwlock);
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */ 
+/*-----------------------------------*/
+
+static llmap_node_t *
+_llmap_node(llmap_t * map, uint64_t off)
+/* Translates off into a node pointer. Returns NULL for
+** the end of the list and for offsets outside the node
+** area, so a corrupt file cannot lead outside the map.
+**/
+{
+  if (off < sizeof(llmap_header_t)
+      || off > map->len - sizeof(llmap_node_t)
+      || (off - sizeof(llmap_header_t)) % sizeof(llmap_node_t) != 0)
+    return NULL;
+  return (llmap_node_t *)(map->base + off);
+}
+
+static llmap_node_t *
+_llmap_chain(llmap_t * map, uint64_t off, uint64_t idx)
+/* Same as _llmap_node for the node at position idx of the
+** mapped chain. A valid file chains at most node_count
+** nodes, so past that the offsets must loop and NULL is
+** returned instead.
+**/
+{
+  if (idx >= map->node_count)
+    return NULL;
+  return _llmap_node(map, off);
+}
+
+static int
+_llmap_before(llorder_type_t order, int lhs, int rhs)
+/* Returns 1 if lhs sorts strictly before rhs in order.
+** For unordered maps every value comes "before" so that
+** scans run to the end.
+**/
+{
+  if (order == ASC)
+    return lhs < rhs;
+  if (order == DESC)
+    return lhs > rhs;
+  return lhs != rhs;
+}
+
+static int
+_llmap_write(char const * path, llorder_type_t order, size_t sz,
+             llmap_source_t source, void * ctx)
+/* Writes the sz values produced by source to path as a
+** contiguous chain of nodes.
+**/
+{
+  llmap_header_t header;
+  llmap_node_t * buf;
+  uint64_t off;
+  size_t i, n;
+  int fd, value, ret;
+
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return -1;
+
+  buf = (llmap_node_t *) malloc(sizeof(llmap_node_t) * LLMAP_CHUNK);
+  if (buf == NULL)
+  {
+    close(fd);
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LLMAP_MAGIC, sizeof(header.magic));
+  header.version = LLMAP_VERSION;
+  header.order = (uint32_t)order;
+  header.sz = (uint64_t)sz;
+  header.node_count = (uint64_t)sz;
+  header.head = sz ? sizeof(llmap_header_t) : 0;
+  ret = llio_write_all(fd, &header, sizeof(header));
+
+  off = sizeof(llmap_header_t);
+  for (i = 0; ret == 0 && i < sz; i += n)
+  {
+    for (n = 0; n < LLMAP_CHUNK && i + n < sz && source(ctx, &value); n++)
+    {
+      off += sizeof(llmap_node_t);
+      buf[n].data = (int32_t)value;
+      buf[n].reserved = 0;
+      buf[n].next = (i + n + 1 < sz) ? off : 0;
+    }
+    if (n == 0)
+      ret = -1; /* Source ran dry before sz values */
+    else
+      ret = llio_write_all(fd, buf, n * sizeof(llmap_node_t));
+  }
+
+  free(buf);
+  if (close(fd) != 0)
+    ret = -1;
+  return ret;
+}
+
+static int
+_llmap_llist_source(void * ctx, int * data)
+{
+  llmap_llist_cursor_t * cursor = (llmap_llist_cursor_t *)ctx;
+  if (cursor->llnode == NULL)
+    return 0;
+  *data = cursor->llnode->data;
+  cursor->llnode = llist_next(cursor->llist, cursor->llnode);
+  return 1;
+}
+
+static int
+_llmap_iter_source(void * ctx, int * data)
+{
+  return llmap_iter_next((llmap_iter_t *)ctx, data);
+}
@@ -0,0 +1,543 @@
+#include <string.h>
+
+#include "../headers/llpack.h"
+
+/* A gap between two int32_t values fits in 32 bits,
+** which takes at most 5 varint bytes */
+#define LLPACK_MAX_GAP_BYTES 5
+
+/*-----------------------------------*/
+/* Helper Functions Declarations     */
+/*-----------------------------------*/
+static size_t _llpack_find(llpack_t const *, int);
+static size_t _llpack_find_insert(llpack_t const *, int);
+static int _llpack_add_block(llpack_t *, size_t);
+static void _llpack_remove_block(llpack_t *, size_t);
+static int _llpack_encode(llpack_block_t *, int32_t const *, uint32_t);
+static uint32_t _llpack_decode(llpack_block_t const *, int32_t *);
+static uint32_t _llpack_read_gap(uint8_t const **);
+static size_t _llpack_range_walk(llpack_t *, int, int, int *, size_t, int64_t *);
+
+/*-----------------------------------*/
+/* Function Definitions              */
+/*-----------------------------------*/
+
+llpack_t *
+llpack_create(llorder_type_t order)
+/* Creates an empty pack. Only ASC and DESC orders are
+** supported, returns NULL for NONE or on error.
+**/
+{
+  llpack_t * pack;
+
+  if (order != ASC && order != DESC)
+    return NULL;
+
+  pack = (llpack_t *) calloc(1, sizeof(llpack_t));
+  if (pack == NULL)
+    return NULL;
+
+  pack->order = order;
+  pthread_rwlock_init(&pack->rwlock, NULL);
+  return pack;
+}
+
+llpack_t *
+llpack_from_llist(llist_t * llist)
+/* Creates a pack holding the values of an ordered llist.
+** The values are copied out with llist_to_array(...) and
+** packed into full blocks. Returns NULL if llist is NULL
+** or unordered, or on error.
+**/
+{
+  llpack_t * pack;
+  int32_t * values;
+  int * data;
+  size_t n, i;
+
+  if (llist == NULL || (pack = llpack_create(llist->order)) == NULL)
+    return NULL;
+
+  n = llist->sz;
+  data = (int *) malloc(sizeof(int) * (n ? n : 1));
+  values = (int32_t *) malloc(sizeof(int32_t) * (n ? n : 1));
+  if (data == NULL || values == NULL)
+  {
+    free(data);
+    free(values);
+    llpack_free(pack);
+    return NULL;
+  }
+
+  /* Blocks are always ascending */
+  n = llist_to_array(llist, data, n);
+  for (i = 0; i < n; i++)
+    values[i] = (int32_t)(pack->order == DESC ? data[n - 1 - i] : data[i]);
+  free(data);
+
+  for (i = 0; i < n; i += LLPACK_BLOCK_VALUES)
+  {
+    uint32_t count = (uint32_t)(n - i < LLPACK_BLOCK_VALUES ? n - i : LLPACK_BLOCK_VALUES);
+
+    if (_llpack_add_block(pack, pack->num_blocks) != 0
+        || _llpack_encode(&pack->blocks[pack->num_blocks - 1], values + i, count) != 0)
+    {
+      free(values);
+      llpack_free(pack);
+      return NULL;
+    }
+    pack->sz += count;
+  }
+
+  free(values);
+  return pack;
+}
+
+void
+llpack_free(llpack_t * pack)
+/* Frees pack and all of its blocks.
+**/
+{
+  size_t i;
+
+  if (pack == NULL)
+    return;
+
+  for (i = 0; i < pack->num_blocks; i++)
+    free(pack->blocks[i].gaps);
+  free(pack->blocks);
+  pthread_rwlock_destroy(&pack->rwlock);
+  free(pack);
+}
+
+int
+llpack_insert(llpack_t * pack, int data)
+/* Inserts data after any equal values. The block it
+** belongs to is decoded, updated and re-encoded, and
+** split in two once it holds too many values. Returns 0
+** on success or -1 on error.
+**/
+{
+  int32_t values[LLPACK_BLOCK_VALUES + 1];
+  llpack_block_t * block;
+  uint32_t n, pos, half;
+  size_t i;
+  int ret = 0;
+
+  if (pack == NULL)
+    return -1;
+
+  pthread_rwlock_wrlock(&pack->rwlock);
+
+  if (pack->num_blocks == 0)
+  {
+    values[0] = (int32_t)data;
+    ret = _llpack_add_block(pack, 0);
+    if (ret == 0 && (ret = _llpack_encode(&pack->blocks[0], values, 1)) != 0)
+      _llpack_remove_block(pack, 0);
+  }
+  else
+  {
+    i = _llpack_find_insert(pack, data);
+    n = _llpack_decode(&pack->blocks[i], values);
+    for (pos = n; pos > 0 && values[pos - 1] > data; pos--)
+      ;
+    memmove(values + pos + 1, values + pos, sizeof(int32_t) * (n - pos));
+    values[pos] = (int32_t)data;
+    n++;
+
+    if (n <= LLPACK_BLOCK_VALUES)
+      ret = _llpack_encode(&pack->blocks[i], values, n);
+
+    /* Splits into two half full blocks, the upper half
+       is encoded first so a failure leaves block i as is */
+    else if ((ret = _llpack_add_block(pack, i + 1)) == 0)
+    {
+      half = n / 2;
+      block = &pack->blocks[i + 1];
+      ret = _llpack_encode(block, values + half, n - half);
+      if (ret == 0 && (ret = _llpack_encode(&pack->blocks[i], values, half)) != 0)
+        free(block->gaps);
+      if (ret != 0)
+        _llpack_remove_block(pack, i + 1);
+    }
+  }
+
+  if (ret == 0)
+    pack->sz++;
+
+  pthread_rwlock_unlock(&pack->rwlock);
+  return ret;
+}
+
+int
+llpack_delete(llpack_t * pack, int data)
+/* Removes one occurrence of data. Returns 1 if a value
+** was removed, 0 if data is not in pack or -1 on error.
+**/
+{
+  int32_t values[LLPACK_BLOCK_VALUES];
+  uint32_t n, pos;
+  size_t i;
+  int ret = 0;
+
+  if (pack == NULL)
+    return -1;
+
+  pthread_rwlock_wrlock(&pack->rwlock);
+
+  i = _llpack_find(pack, data);
+  if (i < pack->num_blocks && pack->blocks[i].first <= data)
+  {
+    n = _llpack_decode(&pack->blocks[i], values);
+    for (pos = 0; pos < n && values[pos] < data; pos++)
+      ;
+
+    if (pos < n && values[pos] == data)
+    {
+      memmove(values + pos, values + pos + 1, sizeof(int32_t) * (n - pos - 1));
+      n--;
+
+      if (n == 0)
+      {
+        free(pack->blocks[i].gaps);
+        _llpack_remove_block(pack, i);
+        ret = 1;
+      }
+      else
+        ret = _llpack_encode(&pack->blocks[i], values, n) == 0 ? 1 : -1;
+
+      if (ret == 1)
+        pack->sz--;
+    }
+  }
+
+  pthread_rwlock_unlock(&pack->rwlock);
+  return ret;
+}
+
+int
+llpack_contains(llpack_t * pack, int data)
+/* Returns 1 if pack holds data or 0 otherwise. Only the
+** block whose range covers data is decoded, and only up
+** to the first value not below data.
+**/
+{
+  llpack_block_t const * block;
+  uint8_t const * gap;
+  int32_t value;
+  uint32_t k;
+  size_t i;
+  int found = 0;
+
+  if (pack == NULL)
+    return 0;
+
+  pthread_rwlock_rdlock(&pack->rwlock);
+
+  i = _llpack_find(pack, data);
+  if (i < pack->num_blocks)
+  {
+    block = &pack->blocks[i];
+    value = block->first;
+    gap = block->gaps;
+    for (k = 1; k < block->count && value < data; k++)
+      value = (int32_t)((uint32_t)value + _llpack_read_gap(&gap));
+    found = value == data;
+  }
+
+  pthread_rwlock_unlock(&pack->rwlock);
+  return found;
+}
+
+int
+llpack_at(llpack_t * pack, size_t idx, int * data)
+/* Stores the value at position idx, in the order of
+** pack, in data. Skips whole blocks by their counts.
+** Returns 0 on success or -1 if idx is out of bounds.
+**/
+{
+  int32_t values[LLPACK_BLOCK_VALUES];
+  size_t i;
+  int ret = -1;
+
+  if (pack == NULL || data == NULL)
+    return -1;
+
+  pthread_rwlock_rdlock(&pack->rwlock);
+
+  if (idx < pack->sz)
+  {
+    if (pack->order == DESC)
+      idx = pack->sz - 1 - idx;
+
+    for (i = 0; idx >= pack->blocks[i].count; i++)
+      idx -= pack->blocks[i].count;
+
+    _llpack_decode(&pack->blocks[i], values);
+    *data = values[idx];
+    ret = 0;
+  }
+
+  pthread_rwlock_unlock(&pack->rwlock);
+  return ret;
+}
+
+size_t
+llpack_range_count(llpack_t * pack, int lo, int hi)
+/* Returns the number of values in [lo, hi].
+**/
+{
+  return _llpack_range_walk(pack, lo, hi, NULL, SIZE_MAX, NULL);
+}
+
+int64_t
+llpack_range_sum(llpack_t * pack, int lo, int hi)
+/* Returns the sum of the values in [lo, hi].
+**/
+{
+  int64_t sum = 0;
+  _llpack_range_walk(pack, lo, hi, NULL, SIZE_MAX, &sum);
+  return sum;
+}
+
+size_t
+llpack_range_copy(llpack_t * pack, int lo, int hi, int * out, size_t cap)
+/* Copies up to cap values in [lo, hi] into out in
+** ascending order. Returns the number of values copied.
+**/
+{
+  if (out == NULL)
+    return 0;
+  return _llpack_range_walk(pack, lo, hi, out, cap, NULL);
+}
+
+size_t
+llpack_bytes(llpack_t * pack)
+/* Returns the number of bytes allocated for pack, not
+** counting allocator overhead.
+**/
+{
+  size_t bytes;
+  size_t i;
+
+  if (pack == NULL)
+    return 0;
+
+  pthread_rwlock_rdlock(&pack->rwlock);
+  bytes = sizeof(llpack_t) + pack->cap_blocks * sizeof(llpack_block_t);
+  for (i = 0; i < pack->num_blocks; i++)
+    bytes += pack->blocks[i].len;
+  pthread_rwlock_unlock(&pack->rwlock);
+
+  return bytes;
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */ 
+/*-----------------------------------*/
+
+static size_t
+_llpack_find(llpack_t const * pack, int data)
+/* Returns the index of the first block whose last value
+** is not below data, or num_blocks if there is none.
+**/
+{
+  size_t lo = 0;
+  size_t hi = pack->num_blocks;
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (pack->blocks[mid].last < data)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static size_t
+_llpack_find_insert(llpack_t const * pack, int data)
+/* Returns the index of the last block whose first value
+** is not above data, or 0 if data is below all blocks.
+** pack must have at least one block.
+**/
+{
+  size_t lo = 0;
+  size_t hi = pack->num_blocks;
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (pack->blocks[mid].first <= data)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo ? lo - 1 : 0;
+}
+
+static int
+_llpack_add_block(llpack_t * pack, size_t idx)
+/* Opens an empty block descriptor at idx, growing the
+** index if needed. Returns 0 on success or -1.
+**/
+{
+  if (pack->num_blocks == pack->cap_blocks)
+  {
+    size_t cap = pack->cap_blocks ? pack->cap_blocks * 2 : 4;
+    llpack_block_t * blocks =
+      (llpack_block_t *) realloc(pack->blocks, cap * sizeof(llpack_block_t));
+    if (blocks == NULL)
+      return -1;
+    pack->blocks = blocks;
+    pack->cap_blocks = cap;
+  }
+
+  memmove(pack->blocks + idx + 1, pack->blocks + idx,
+          (pack->num_blocks - idx) * sizeof(llpack_block_t));
+  memset(&pack->blocks[idx], 0, sizeof(llpack_block_t));
+  pack->num_blocks++;
+  return 0;
+}
+
+static void
+_llpack_remove_block(llpack_t * pack, size_t idx)
+/* Closes the descriptor at idx. Does not free its gaps.
+**/
+{
+  pack->num_blocks--;
+  memmove(pack->blocks + idx, pack->blocks + idx + 1,
+          (pack->num_blocks - idx) * sizeof(llpack_block_t));
+}
+
+static int
+_llpack_encode(llpack_block_t * block, int32_t const * values, uint32_t n)
+/* Replaces the contents of block with the n ascending
+** values. The gaps are encoded into a buffer of exactly
+** the needed size. Returns 0 on success or -1, in which
+** case block is unchanged.
+**/
+{
+  uint8_t buf[LLPACK_BLOCK_VALUES * LLPACK_MAX_GAP_BYTES];
+  uint8_t * gaps = NULL;
+  uint32_t len = 0;
+  uint32_t k;
+
+  for (k = 1; k < n; k++)
+  {
+    uint32_t gap = (uint32_t)values[k] - (uint32_t)values[k - 1];
+    while (gap >= 0x80)
+    {
+      buf[len++] = (uint8_t)(gap | 0x80);
+      gap >>= 7;
+    }
+    buf[len++] = (uint8_t)gap;
+  }
+
+  if (len > 0)
+  {
+    gaps = (uint8_t *) malloc(len);
+    if (gaps == NULL)
+      return -1;
+    memcpy(gaps, buf, len);
+  }
+
+  free(block->gaps);
+  block->gaps = gaps;
+  block->len = len;
+  block->count = n;
+  block->first = values[0];
+  block->last = values[n - 1];
+  return 0;
+}
+
+static uint32_t
+_llpack_decode(llpack_block_t const * block, int32_t * values)
+/* Decodes all values of block into values and returns
+** their count.
+**/
+{
+  uint8_t const * gap = block->gaps;
+  uint32_t k;
+
+  values[0] = block->first;
+  for (k = 1; k < block->count; k++)
+    values[k] = (int32_t)((uint32_t)values[k - 1] + _llpack_read_gap(&gap));
+  return block->count;
+}
+
+static uint32_t
+_llpack_read_gap(uint8_t const ** cur)
+/* Reads one varint and advances cur past it.
+**/
+{
+  uint32_t gap = 0;
+  int shift = 0;
+  uint8_t byte;
+
+  do
+  {
+    byte = *(*cur)++;
+    gap |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return gap;
+}
+
+static size_t
+_llpack_range_walk(llpack_t * pack,
+                   int lo,
+                   int hi,
+                   int * out,
+                   size_t cap,
+                   int64_t * sum)
+/* Visits up to cap values in [lo, hi] in ascending order
+** under a single read lock, copying them into out and
+** adding them to sum when those are not NULL. Starts at
+** the first block that can hold lo and decodes blocks on
+** the fly until a value above hi. Returns the number
+** visited.
+**/
+{
+  llpack_block_t const * block;
+  uint8_t const * gap;
+  int32_t value;
+  uint32_t k;
+  size_t i;
+  size_t n = 0;
+
+  if (pack == NULL || lo > hi)
+    return 0;
+
+  pthread_rwlock_rdlock(&pack->rwlock);
+
+  for (i = _llpack_find(pack, lo);
+       i < pack->num_blocks && pack->blocks[i].first <= hi && n < cap;
+       i++)
+  {
+    block = &pack->blocks[i];
+    gap = block->gaps;
+    value = block->first;
+    for (k = 0; k < block->count && n < cap; k++)
+    {
+      if (k > 0)
+        value = (int32_t)((uint32_t)value + _llpack_read_gap(&gap));
+      if (value < lo)
+        continue;
+      if (value > hi)
+        break;
+
+      if (out)
+        out[n] = value;
+      if (sum)
+        *sum += value;
+      n++;
+    }
+  }
+
+  pthread_rwlock_unlock(&pack->rwlock);
+  return n;
+}
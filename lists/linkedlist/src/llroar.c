@@ -0,0 +1,1031 @@
+#include <string.h>
+
+#include "../headers/llroar.h"
+
+/* Set operations combined by _llroar_op */
+typedef enum { LLROAR_AND, LLROAR_OR, LLROAR_ANDNOT } llroar_op_t;
+
+/*-----------------------------------*/
+/* Helper Functions Declarations     */
+/*-----------------------------------*/
+static void _llroar_split(int, uint16_t *, uint16_t *);
+static int _llroar_join(uint16_t, uint16_t);
+static size_t _llroar_find(llroar_t const *, uint16_t, int *);
+static llroar_container_t * _llroar_add_container(llroar_t *, size_t, uint16_t);
+static void _llroar_remove_container(llroar_t *, size_t);
+static uint32_t _llroar_array_find(uint16_t const *, uint32_t, uint16_t);
+static int _llroar_container_contains(llroar_container_t const *, uint16_t);
+static int _llroar_container_add(llroar_container_t *, uint16_t);
+static int _llroar_container_remove(llroar_container_t *, uint16_t);
+static uint16_t _llroar_container_select(llroar_container_t const *, uint32_t);
+static int _llroar_container_copy(llroar_container_t *, llroar_container_t const *);
+static size_t _llroar_container_bytes(llroar_container_t const *);
+static void _llroar_to_words(llroar_container_t const *, uint64_t *);
+static int _llroar_from_words(llroar_container_t *, uint64_t const *);
+static int _llroar_from_values(llroar_container_t *, uint16_t const *, uint32_t);
+static int _llroar_to_runs(llroar_container_t *, uint64_t const *, uint32_t);
+static int _llroar_unrun(llroar_container_t *);
+static llroar_t * _llroar_op(llroar_t *, llroar_t *, llroar_op_t);
+static int _llroar_combine(llroar_t *, llroar_container_t const *,
+                           llroar_container_t const *, llroar_op_t);
+static void _llroar_lock_pair(llroar_t *, llroar_t *);
+static void _llroar_unlock_pair(llroar_t *, llroar_t *);
+static int _llroar_int_comparitor(void const *, void const *);
+
+/*-----------------------------------*/
+/* Function Definitions              */
+/*-----------------------------------*/
+
+llroar_t *
+llroar_create(void)
+/* Creates an empty set. Returns NULL on error.
+**/
+{
+  llroar_t * roar = (llroar_t *) calloc(1, sizeof(llroar_t));
+  if (roar)
+    pthread_rwlock_init(&roar->rwlock, NULL);
+  return roar;
+}
+
+llroar_t *
+llroar_from_llist(llist_t * llist)
+/* Creates a set of the distinct values of llist. The
+** values are copied out with llist_to_array(...), sorted
+** and appended container by container, and containers
+** are then converted to runs where that is smaller.
+** Returns NULL on error.
+**/
+{
+  llroar_t * roar;
+  llroar_container_t * c = NULL;
+  uint16_t key, low;
+  int * data;
+  size_t n, i;
+
+  if (llist == NULL || (roar = llroar_create()) == NULL)
+    return NULL;
+
+  n = llist->sz;
+  data = (int *) malloc(sizeof(int) * (n ? n : 1));
+  if (data == NULL)
+  {
+    llroar_free(roar);
+    return NULL;
+  }
+
+  n = llist_to_array(llist, data, n);
+  if (llist->order != ASC)
+    qsort(data, n, sizeof(int), _llroar_int_comparitor);
+
+  for (i = 0; i < n; i++)
+  {
+    if (i > 0 && data[i] == data[i - 1])
+      continue;
+
+    _llroar_split(data[i], &key, &low);
+    if ((c == NULL || c->key != key)
+        && (c = _llroar_add_container(roar, roar->num_containers, key)) == NULL)
+      break;
+    if (_llroar_container_add(c, low) < 0)
+      break;
+    roar->sz++;
+  }
+
+  free(data);
+  if (i < n)
+  {
+    llroar_free(roar);
+    return NULL;
+  }
+
+  llroar_optimize(roar);
+  return roar;
+}
+
+void
+llroar_free(llroar_t * roar)
+/* Frees roar and all of its containers.
+**/
+{
+  size_t i;
+
+  if (roar == NULL)
+    return;
+
+  for (i = 0; i < roar->num_containers; i++)
+    free(roar->containers[i].data);
+  free(roar->containers);
+  pthread_rwlock_destroy(&roar->rwlock);
+  free(roar);
+}
+
+int
+llroar_insert(llroar_t * roar, int data)
+/* Adds data to roar. Returns 1 if it was added, 0 if it
+** was already present or -1 on error.
+**/
+{
+  llroar_container_t * c;
+  uint16_t key, low;
+  size_t idx;
+  int found;
+  int ret = -1;
+
+  if (roar == NULL)
+    return -1;
+
+  _llroar_split(data, &key, &low);
+  pthread_rwlock_wrlock(&roar->rwlock);
+
+  idx = _llroar_find(roar, key, &found);
+  c = found ? &roar->containers[idx] : _llroar_add_container(roar, idx, key);
+  if (c)
+  {
+    ret = _llroar_container_add(c, low);
+    if (ret == 1)
+      roar->sz++;
+    else if (c->card == 0)
+      _llroar_remove_container(roar, idx);
+  }
+
+  pthread_rwlock_unlock(&roar->rwlock);
+  return ret;
+}
+
+int
+llroar_delete(llroar_t * roar, int data)
+/* Removes data from roar. Returns 1 if it was removed,
+** 0 if it was not present or -1 on error.
+**/
+{
+  llroar_container_t * c;
+  uint16_t key, low;
+  size_t idx;
+  int found;
+  int ret = 0;
+
+  if (roar == NULL)
+    return -1;
+
+  _llroar_split(data, &key, &low);
+  pthread_rwlock_wrlock(&roar->rwlock);
+
+  idx = _llroar_find(roar, key, &found);
+  if (found)
+  {
+    c = &roar->containers[idx];
+    ret = _llroar_container_remove(c, low);
+    if (ret == 1)
+    {
+      roar->sz--;
+      if (c->card == 0)
+      {
+        free(c->data);
+        _llroar_remove_container(roar, idx);
+      }
+    }
+  }
+
+  pthread_rwlock_unlock(&roar->rwlock);
+  return ret;
+}
+
+int
+llroar_contains(llroar_t * roar, int data)
+/* Returns 1 if roar holds data or 0 otherwise. A single
+** bit test for bitmap containers.
+**/
+{
+  uint16_t key, low;
+  size_t idx;
+  int found;
+
+  if (roar == NULL)
+    return 0;
+
+  _llroar_split(data, &key, &low);
+  pthread_rwlock_rdlock(&roar->rwlock);
+
+  idx = _llroar_find(roar, key, &found);
+  found = found && _llroar_container_contains(&roar->containers[idx], low);
+
+  pthread_rwlock_unlock(&roar->rwlock);
+  return found;
+}
+
+int
+llroar_at(llroar_t * roar, size_t idx, int * data)
+/* Stores the value at position idx in ascending order in
+** data. Whole containers are skipped by cardinality and
+** bitmaps are searched a popcount per word. Returns 0 on
+** success or -1 if idx is out of bounds.
+**/
+{
+  llroar_container_t const * c;
+  size_t i;
+  int ret = -1;
+
+  if (roar == NULL || data == NULL)
+    return -1;
+
+  pthread_rwlock_rdlock(&roar->rwlock);
+
+  if (idx < roar->sz)
+  {
+    for (i = 0; idx >= roar->containers[i].card; i++)
+      idx -= roar->containers[i].card;
+
+    c = &roar->containers[i];
+    *data = _llroar_join(c->key, _llroar_container_select(c, (uint32_t)idx));
+    ret = 0;
+  }
+
+  pthread_rwlock_unlock(&roar->rwlock);
+  return ret;
+}
+
+size_t
+llroar_to_array(llroar_t * roar, int * out, size_t cap)
+/* Copies up to cap values of roar into out in ascending
+** order. Returns the number of values copied.
+**/
+{
+  llroar_container_t const * c;
+  size_t n = 0;
+  size_t i;
+  uint32_t k, v;
+
+  if (roar == NULL || out == NULL)
+    return 0;
+
+  pthread_rwlock_rdlock(&roar->rwlock);
+
+  for (i = 0; i < roar->num_containers && n < cap; i++)
+  {
+    c = &roar->containers[i];
+    if (c->type == LLROAR_ARRAY)
+    {
+      uint16_t const * values = (uint16_t const *)c->data;
+      for (k = 0; k < c->n && n < cap; k++)
+        out[n++] = _llroar_join(c->key, values[k]);
+    }
+    else if (c->type == LLROAR_BITMAP)
+    {
+      uint64_t const * words = (uint64_t const *)c->data;
+      for (k = 0; k < LLROAR_BITMAP_WORDS && n < cap; k++)
+      {
+        uint64_t word = words[k];
+        while (word && n < cap)
+        {
+          v = k * 64 + (uint32_t)__builtin_ctzll(word);
+          out[n++] = _llroar_join(c->key, (uint16_t)v);
+          word &= word - 1;
+        }
+      }
+    }
+    else
+    {
+      uint16_t const * runs = (uint16_t const *)c->data;
+      for (k = 0; k < c->n && n < cap; k++)
+        for (v = runs[2 * k]; v <= (uint32_t)runs[2 * k] + runs[2 * k + 1] && n < cap; v++)
+          out[n++] = _llroar_join(c->key, (uint16_t)v);
+    }
+  }
+
+  pthread_rwlock_unlock(&roar->rwlock);
+  return n;
+}
+
+llroar_t *
+llroar_and(llroar_t * a, llroar_t * b)
+/* Returns a new set of the values in both a and b, or
+** NULL on error.
+**/
+{
+  return _llroar_op(a, b, LLROAR_AND);
+}
+
+llroar_t *
+llroar_or(llroar_t * a, llroar_t * b)
+/* Returns a new set of the values in a or b, or NULL on
+** error.
+**/
+{
+  return _llroar_op(a, b, LLROAR_OR);
+}
+
+llroar_t *
+llroar_andnot(llroar_t * a, llroar_t * b)
+/* Returns a new set of the values in a but not in b, or
+** NULL on error.
+**/
+{
+  return _llroar_op(a, b, LLROAR_ANDNOT);
+}
+
+void
+llroar_optimize(llroar_t * roar)
+/* Converts every container to whichever of array, bitmap
+** or runs takes the fewest bytes, and trims unused room.
+** Inserts and deletes undo run encoding of the container
+** they touch.
+**/
+{
+  uint64_t words[LLROAR_BITMAP_WORDS];
+  llroar_container_t * c;
+  uint32_t runs, k;
+  size_t i;
+
+  if (roar == NULL)
+    return;
+
+  pthread_rwlock_wrlock(&roar->rwlock);
+
+  for (i = 0; i < roar->num_containers; i++)
+  {
+    c = &roar->containers[i];
+    _llroar_to_words(c, words);
+
+    /* A run starts at every set bit whose lower
+       neighbour is clear */
+    runs = 0;
+    for (k = 0; k < LLROAR_BITMAP_WORDS; k++)
+    {
+      uint64_t carry = k ? words[k - 1] >> 63 : 0;
+      runs += (uint32_t)__builtin_popcountll(words[k] & ~((words[k] << 1) | carry));
+    }
+
+    if (runs * 2 * sizeof(uint16_t)
+        < (c->card <= LLROAR_ARRAY_MAX ? c->card * sizeof(uint16_t)
+                                       : LLROAR_BITMAP_WORDS * sizeof(uint64_t)))
+      _llroar_to_runs(c, words, runs);
+    else if (c->type != LLROAR_BITMAP || c->card <= LLROAR_ARRAY_MAX)
+      _llroar_from_words(c, words);
+  }
+
+  pthread_rwlock_unlock(&roar->rwlock);
+}
+
+size_t
+llroar_bytes(llroar_t * roar)
+/* Returns the number of bytes allocated for roar, not
+** counting allocator overhead.
+**/
+{
+  size_t bytes;
+  size_t i;
+
+  if (roar == NULL)
+    return 0;
+
+  pthread_rwlock_rdlock(&roar->rwlock);
+  bytes = sizeof(llroar_t) + roar->cap_containers * sizeof(llroar_container_t);
+  for (i = 0; i < roar->num_containers; i++)
+    bytes += _llroar_container_bytes(&roar->containers[i]);
+  pthread_rwlock_unlock(&roar->rwlock);
+
+  return bytes;
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */
+/*-----------------------------------*/
+
+static void
+_llroar_split(int data, uint16_t * key, uint16_t * low)
+/* Flipping the sign bit keeps signed order when values
+** are compared as unsigned.
+**/
+{
+  uint32_t u = (uint32_t)data ^ 0x80000000u;
+  *key = (uint16_t)(u >> 16);
+  *low = (uint16_t)u;
+}
+
+static int
+_llroar_join(uint16_t key, uint16_t low)
+{
+  return (int)((((uint32_t)key << 16) | low) ^ 0x80000000u);
+}
+
+static size_t
+_llroar_find(llroar_t const * roar, uint16_t key, int * found)
+/* Returns the index of the container for key, or where
+** it would be inserted, and sets found accordingly.
+**/
+{
+  size_t lo = 0;
+  size_t hi = roar->num_containers;
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (roar->containers[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *found = lo < roar->num_containers && roar->containers[lo].key == key;
+  return lo;
+}
+
+static llroar_container_t *
+_llroar_add_container(llroar_t * roar, size_t idx, uint16_t key)
+/* Opens an empty array container for key at idx. Returns
+** NULL on error.
+**/
+{
+  llroar_container_t * c;
+
+  if (roar->num_containers == roar->cap_containers)
+  {
+    size_t cap = roar->cap_containers ? roar->cap_containers * 2 : 4;
+    llroar_container_t * containers = (llroar_container_t *)
+      realloc(roar->containers, cap * sizeof(llroar_container_t));
+    if (containers == NULL)
+      return NULL;
+    roar->containers = containers;
+    roar->cap_containers = cap;
+  }
+
+  memmove(roar->containers + idx + 1, roar->containers + idx,
+          (roar->num_containers - idx) * sizeof(llroar_container_t));
+  roar->num_containers++;
+
+  c = &roar->containers[idx];
+  memset(c, 0, sizeof(llroar_container_t));
+  c->key = key;
+  c->type = LLROAR_ARRAY;
+  return c;
+}
+
+static void
+_llroar_remove_container(llroar_t * roar, size_t idx)
+/* Closes the container at idx. Does not free its data.
+**/
+{
+  roar->num_containers--;
+  memmove(roar->containers + idx, roar->containers + idx + 1,
+          (roar->num_containers - idx) * sizeof(llroar_container_t));
+}
+
+static uint32_t
+_llroar_array_find(uint16_t const * values, uint32_t n, uint16_t low)
+/* Returns the index of the first value not below low.
+**/
+{
+  uint32_t lo = 0;
+  uint32_t hi = n;
+
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (values[mid] < low)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int
+_llroar_container_contains(llroar_container_t const * c, uint16_t low)
+{
+  if (c->type == LLROAR_BITMAP)
+    return (((uint64_t const *)c->data)[low >> 6] >> (low & 63)) & 1;
+
+  if (c->type == LLROAR_ARRAY)
+  {
+    uint16_t const * values = (uint16_t const *)c->data;
+    uint32_t pos = _llroar_array_find(values, c->n, low);
+    return pos < c->n && values[pos] == low;
+  }
+
+  /* Last run starting at or below low */
+  {
+    uint16_t const * runs = (uint16_t const *)c->data;
+    uint32_t lo = 0;
+    uint32_t hi = c->n;
+
+    while (lo < hi)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (runs[2 * mid] <= low)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo > 0 && low <= (uint32_t)runs[2 * (lo - 1)] + runs[2 * (lo - 1) + 1];
+  }
+}
+
+static int
+_llroar_container_add(llroar_container_t * c, uint16_t low)
+/* Returns 1 if low was added, 0 if it was present or -1
+** on error. Full arrays turn into bitmaps.
+**/
+{
+  uint64_t words[LLROAR_BITMAP_WORDS];
+  uint64_t * bitmap;
+
+  if (c->type == LLROAR_RUN && _llroar_unrun(c) != 0)
+    return -1;
+
+  if (c->type == LLROAR_ARRAY)
+  {
+    uint16_t * values = (uint16_t *)c->data;
+    uint32_t pos = _llroar_array_find(values, c->n, low);
+
+    if (pos < c->n && values[pos] == low)
+      return 0;
+
+    if (c->n < LLROAR_ARRAY_MAX)
+    {
+      if (c->n == c->cap)
+      {
+        uint32_t cap = c->cap ? c->cap * 2 : 4;
+        if (cap > LLROAR_ARRAY_MAX)
+          cap = LLROAR_ARRAY_MAX;
+        values = (uint16_t *) realloc(c->data, cap * sizeof(uint16_t));
+        if (values == NULL)
+          return -1;
+        c->data = values;
+        c->cap = cap;
+      }
+
+      memmove(values + pos + 1, values + pos, (c->n - pos) * sizeof(uint16_t));
+      values[pos] = low;
+      c->n++;
+      c->card++;
+      return 1;
+    }
+
+    _llroar_to_words(c, words);
+    words[low >> 6] |= (uint64_t)1 << (low & 63);
+    return _llroar_from_words(c, words) == 0 ? 1 : -1;
+  }
+
+  bitmap = (uint64_t *)c->data;
+  if ((bitmap[low >> 6] >> (low & 63)) & 1)
+    return 0;
+  bitmap[low >> 6] |= (uint64_t)1 << (low & 63);
+  c->card++;
+  return 1;
+}
+
+static int
+_llroar_container_remove(llroar_container_t * c, uint16_t low)
+/* Returns 1 if low was removed, 0 if it was not present
+** or -1 on error. Bitmaps that become sparse enough turn
+** back into arrays.
+**/
+{
+  uint64_t * bitmap;
+
+  if (!_llroar_container_contains(c, low))
+    return 0;
+
+  if (c->type == LLROAR_RUN && _llroar_unrun(c) != 0)
+    return -1;
+
+  if (c->type == LLROAR_ARRAY)
+  {
+    uint16_t * values = (uint16_t *)c->data;
+    uint32_t pos = _llroar_array_find(values, c->n, low);
+
+    memmove(values + pos, values + pos + 1, (c->n - pos - 1) * sizeof(uint16_t));
+    c->n--;
+    c->card--;
+    return 1;
+  }
+
+  bitmap = (uint64_t *)c->data;
+  bitmap[low >> 6] &= ~((uint64_t)1 << (low & 63));
+  c->card--;
+
+  /* Keeps the bitmap if the array cannot be allocated */
+  if (c->card <= LLROAR_ARRAY_MAX)
+    _llroar_from_words(c, bitmap);
+  return 1;
+}
+
+static uint16_t
+_llroar_container_select(llroar_container_t const * c, uint32_t rank)
+/* Returns the low bits of the value of rank rank in c.
+** rank must be below the cardinality of c.
+**/
+{
+  uint32_t k;
+
+  if (c->type == LLROAR_ARRAY)
+    return ((uint16_t const *)c->data)[rank];
+
+  if (c->type == LLROAR_BITMAP)
+  {
+    uint64_t const * words = (uint64_t const *)c->data;
+    uint64_t word;
+    uint32_t count;
+
+    for (k = 0; ; k++)
+    {
+      count = (uint32_t)__builtin_popcountll(words[k]);
+      if (rank < count)
+        break;
+      rank -= count;
+    }
+
+    for (word = words[k]; rank > 0; rank--)
+      word &= word - 1;
+    return (uint16_t)(k * 64 + (uint32_t)__builtin_ctzll(word));
+  }
+
+  {
+    uint16_t const * runs = (uint16_t const *)c->data;
+    for (k = 0; rank > runs[2 * k + 1]; k++)
+      rank -= (uint32_t)runs[2 * k + 1] + 1;
+    return (uint16_t)(runs[2 * k] + rank);
+  }
+}
+
+static int
+_llroar_container_copy(llroar_container_t * dst, llroar_container_t const * src)
+/* Makes dst an independent copy of src. Returns 0 on
+** success or -1 on error.
+**/
+{
+  size_t bytes;
+
+  *dst = *src;
+  dst->data = NULL;
+  if (src->type == LLROAR_BITMAP)
+    bytes = LLROAR_BITMAP_WORDS * sizeof(uint64_t);
+  else
+  {
+    dst->cap = src->n;
+    bytes = src->n * (src->type == LLROAR_RUN ? 2 : 1) * sizeof(uint16_t);
+  }
+
+  if (bytes > 0)
+  {
+    dst->data = malloc(bytes);
+    if (dst->data == NULL)
+      return -1;
+    memcpy(dst->data, src->data, bytes);
+  }
+  return 0;
+}
+
+static size_t
+_llroar_container_bytes(llroar_container_t const * c)
+{
+  if (c->type == LLROAR_BITMAP)
+    return LLROAR_BITMAP_WORDS * sizeof(uint64_t);
+  if (c->type == LLROAR_RUN)
+    return c->cap * 2 * sizeof(uint16_t);
+  return c->cap * sizeof(uint16_t);
+}
+
+static void
+_llroar_to_words(llroar_container_t const * c, uint64_t * words)
+/* Writes the values of c into words as a bitmap.
+**/
+{
+  uint32_t k, v;
+
+  if (c->type == LLROAR_BITMAP)
+  {
+    if (words != c->data)
+      memcpy(words, c->data, LLROAR_BITMAP_WORDS * sizeof(uint64_t));
+    return;
+  }
+
+  memset(words, 0, LLROAR_BITMAP_WORDS * sizeof(uint64_t));
+  if (c->type == LLROAR_ARRAY)
+  {
+    uint16_t const * values = (uint16_t const *)c->data;
+    for (k = 0; k < c->n; k++)
+      words[values[k] >> 6] |= (uint64_t)1 << (values[k] & 63);
+  }
+  else
+  {
+    uint16_t const * runs = (uint16_t const *)c->data;
+    for (k = 0; k < c->n; k++)
+      for (v = runs[2 * k]; v <= (uint32_t)runs[2 * k] + runs[2 * k + 1]; v++)
+        words[v >> 6] |= (uint64_t)1 << (v & 63);
+  }
+}
+
+static int
+_llroar_from_words(llroar_container_t * c, uint64_t const * words)
+/* Replaces the contents of c with the values set in
+** words, as an array if there are few enough of them and
+** as a bitmap otherwise. words may be the bitmap of c.
+** Returns 0 on success or -1, leaving c unchanged.
+**/
+{
+  uint16_t values[LLROAR_ARRAY_MAX];
+  uint32_t card = 0;
+  uint32_t k;
+  void * data;
+
+  for (k = 0; k < LLROAR_BITMAP_WORDS; k++)
+    card += (uint32_t)__builtin_popcountll(words[k]);
+
+  if (card <= LLROAR_ARRAY_MAX)
+  {
+    uint32_t n = 0;
+    for (k = 0; k < LLROAR_BITMAP_WORDS; k++)
+    {
+      uint64_t word = words[k];
+      while (word)
+      {
+        values[n++] = (uint16_t)(k * 64 + (uint32_t)__builtin_ctzll(word));
+        word &= word - 1;
+      }
+    }
+    return _llroar_from_values(c, values, card);
+  }
+
+  if (c->type == LLROAR_BITMAP && c->data == words)
+  {
+    c->card = card;
+    return 0;
+  }
+
+  data = malloc(LLROAR_BITMAP_WORDS * sizeof(uint64_t));
+  if (data == NULL)
+    return -1;
+  memcpy(data, words, LLROAR_BITMAP_WORDS * sizeof(uint64_t));
+
+  free(c->data);
+  c->data = data;
+  c->type = LLROAR_BITMAP;
+  c->card = card;
+  c->n = 0;
+  c->cap = 0;
+  return 0;
+}
+
+static int
+_llroar_from_values(llroar_container_t * c, uint16_t const * values, uint32_t n)
+/* Replaces the contents of c with an array of the n
+** sorted values. Returns 0 on success or -1, leaving c
+** unchanged.
+**/
+{
+  uint16_t * data = NULL;
+
+  if (n > 0)
+  {
+    data = (uint16_t *) malloc(n * sizeof(uint16_t));
+    if (data == NULL)
+      return -1;
+    memcpy(data, values, n * sizeof(uint16_t));
+  }
+
+  free(c->data);
+  c->data = data;
+  c->type = LLROAR_ARRAY;
+  c->card = n;
+  c->n = n;
+  c->cap = n;
+  return 0;
+}
+
+static int
+_llroar_to_runs(llroar_container_t * c, uint64_t const * words, uint32_t runs)
+/* Replaces the contents of c with the runs of set bits
+** in words. Returns 0 on success or -1, leaving c as is.
+**/
+{
+  uint16_t * data;
+  uint32_t n = 0;
+  uint32_t v = 0;
+
+  data = (uint16_t *) malloc(runs * 2 * sizeof(uint16_t));
+  if (data == NULL)
+    return -1;
+
+  while (v < 65536)
+  {
+    uint32_t start;
+
+    while (v < 65536 && !((words[v >> 6] >> (v & 63)) & 1))
+      v++;
+    if (v == 65536)
+      break;
+
+    start = v;
+    while (v < 65536 && ((words[v >> 6] >> (v & 63)) & 1))
+      v++;
+
+    data[2 * n] = (uint16_t)start;
+    data[2 * n + 1] = (uint16_t)(v - 1 - start);
+    n++;
+  }
+
+  free(c->data);
+  c->data = data;
+  c->type = LLROAR_RUN;
+  c->n = n;
+  c->cap = n;
+  return 0;
+}
+
+static int
+_llroar_unrun(llroar_container_t * c)
+/* Turns a run container into an array or a bitmap so it
+** can be modified in place.
+**/
+{
+  uint64_t words[LLROAR_BITMAP_WORDS];
+  _llroar_to_words(c, words);
+  return _llroar_from_words(c, words);
+}
+
+static llroar_t *
+_llroar_op(llroar_t * a, llroar_t * b, llroar_op_t op)
+/* Walks the containers of a and b by key in a single
+** merge. Containers found on one side only are copied
+** or skipped whole, matching ones are combined.
+**/
+{
+  llroar_container_t const * ca;
+  llroar_container_t const * cb;
+  llroar_container_t * c;
+  llroar_t * res;
+  size_t i = 0;
+  size_t j = 0;
+  int err = 0;
+
+  if (a == NULL || b == NULL || (res = llroar_create()) == NULL)
+    return NULL;
+
+  _llroar_lock_pair(a, b);
+
+  while (!err && (i < a->num_containers || j < b->num_containers))
+  {
+    size_t num_containers = res->num_containers;
+
+    ca = i < a->num_containers ? &a->containers[i] : NULL;
+    cb = j < b->num_containers ? &b->containers[j] : NULL;
+
+    if (cb == NULL || (ca && ca->key < cb->key))
+    {
+      if (op != LLROAR_AND)
+      {
+        c = _llroar_add_container(res, res->num_containers, ca->key);
+        err = c == NULL || _llroar_container_copy(c, ca) != 0;
+      }
+      i++;
+    }
+    else if (ca == NULL || cb->key < ca->key)
+    {
+      if (op == LLROAR_OR)
+      {
+        c = _llroar_add_container(res, res->num_containers, cb->key);
+        err = c == NULL || _llroar_container_copy(c, cb) != 0;
+      }
+      j++;
+    }
+    else
+    {
+      err = _llroar_combine(res, ca, cb, op) != 0;
+      i++;
+      j++;
+    }
+
+    /* Drops empty combinations */
+    if (!err && res->num_containers > num_containers)
+    {
+      c = &res->containers[num_containers];
+      res->sz += c->card;
+      if (c->card == 0)
+      {
+        free(c->data);
+        _llroar_remove_container(res, num_containers);
+      }
+    }
+  }
+
+  _llroar_unlock_pair(a, b);
+
+  if (err)
+  {
+    llroar_free(res);
+    return NULL;
+  }
+  return res;
+}
+
+static int
+_llroar_combine(llroar_t * res,
+                llroar_container_t const * ca,
+                llroar_container_t const * cb,
+                llroar_op_t op)
+/* Appends the combination of two containers with the
+** same key to res. Two arrays are merged directly, all
+** other pairs go through bitmap words. Returns 0 on
+** success or -1 on error.
+**/
+{
+  uint64_t wa[LLROAR_BITMAP_WORDS];
+  uint64_t wb[LLROAR_BITMAP_WORDS];
+  uint16_t merged[2 * LLROAR_ARRAY_MAX];
+  llroar_container_t * c;
+  uint32_t k;
+
+  c = _llroar_add_container(res, res->num_containers, ca->key);
+  if (c == NULL)
+    return -1;
+
+  if (ca->type == LLROAR_ARRAY && cb->type == LLROAR_ARRAY)
+  {
+    uint16_t const * va = (uint16_t const *)ca->data;
+    uint16_t const * vb = (uint16_t const *)cb->data;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t n = 0;
+
+    while (x < ca->n || y < cb->n)
+    {
+      if (y == cb->n || (x < ca->n && va[x] < vb[y]))
+      {
+        if (op != LLROAR_AND)
+          merged[n++] = va[x];
+        x++;
+      }
+      else if (x == ca->n || vb[y] < va[x])
+      {
+        if (op == LLROAR_OR)
+          merged[n++] = vb[y];
+        y++;
+      }
+      else
+      {
+        if (op != LLROAR_ANDNOT)
+          merged[n++] = va[x];
+        x++;
+        y++;
+      }
+    }
+
+    if (n <= LLROAR_ARRAY_MAX)
+      return _llroar_from_values(c, merged, n);
+
+    memset(wa, 0, sizeof(wa));
+    for (k = 0; k < n; k++)
+      wa[merged[k] >> 6] |= (uint64_t)1 << (merged[k] & 63);
+    return _llroar_from_words(c, wa);
+  }
+
+  _llroar_to_words(ca, wa);
+  _llroar_to_words(cb, wb);
+  for (k = 0; k < LLROAR_BITMAP_WORDS; k++)
+  {
+    if (op == LLROAR_AND)
+      wa[k] &= wb[k];
+    else if (op == LLROAR_OR)
+      wa[k] |= wb[k];
+    else
+      wa[k] &= ~wb[k];
+  }
+  return _llroar_from_words(c, wa);
+}
+
+static void
+_llroar_lock_pair(llroar_t * a, llroar_t * b)
+/* Read locks two sets in address order.
+**/
+{
+  if (a == b)
+  {
+    pthread_rwlock_rdlock(&a->rwlock);
+    return;
+  }
+
+  if ((uintptr_t)b < (uintptr_t)a)
+  {
+    llroar_t * tmp = a;
+    a = b;
+    b = tmp;
+  }
+  pthread_rwlock_rdlock(&a->rwlock);
+  pthread_rwlock_rdlock(&b->rwlock);
+}
+
+static void
+_llroar_unlock_pair(llroar_t * a, llroar_t * b)
+{
+  pthread_rwlock_unlock(&a->rwlock);
+  if (a != b)
+    pthread_rwlock_unlock(&b->rwlock);
+}
+
+static int
+_llroar_int_comparitor(void const * lhs, void const * rhs)
+{
+  int l = *(int const *)lhs;
+  int r = *(int const *)rhs;
+  return (l > r) - (l < r);
+}
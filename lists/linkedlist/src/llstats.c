@@ -0,0 +1,117 @@
+#include <time.h>
+
+#include "../headers/llstats.h"
+
+/*-----------------------------------*/
+/* Helper Functions Declarations     */
+/*-----------------------------------*/
+static int _llstats_bucket(uint64_t);
+
+/*-----------------------------------*/
+/* Function Definitions              */
+/*-----------------------------------*/
+
+uint64_t
+llstats_now(void)
+/* Returns a monotonic timestamp in nanoseconds.
+**/
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void
+llstats_add(uint64_t * counter, uint64_t n)
+/* Atomically adds n to counter. Counters are updated
+** by concurrent readers, so plain increments would
+** lose samples.
+**/
+{
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+void
+llstats_record(llstats_hist_t * hist, uint64_t v)
+/* Records sample v in hist.
+**/
+{
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+  llstats_add(&hist->count, 1);
+  llstats_add(&hist->sum, v);
+  llstats_add(&hist->buckets[_llstats_bucket(v)], 1);
+
+  while (v > max
+         && !__atomic_compare_exchange_n(&hist->max, &max, v, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void
+llstats_copy(llist_stats_t * dst, llist_stats_t * src)
+/* Copies src into dst one counter at a time. The copy
+** is not an atomic snapshot of all counters, but no
+** individual counter is ever torn.
+**/
+{
+  uint64_t * from = (uint64_t *)src;
+  uint64_t * to = (uint64_t *)dst;
+  size_t i;
+  for (i = 0; i < sizeof(llist_stats_t) / sizeof(uint64_t); i++)
+    to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+}
+
+void
+llstats_reset(llist_stats_t * stats)
+/* Zeroes every counter in stats.
+**/
+{
+  uint64_t * counters = (uint64_t *)stats;
+  size_t i;
+  for (i = 0; i < sizeof(llist_stats_t) / sizeof(uint64_t); i++)
+    __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+}
+
+uint64_t
+llstats_percentile(llstats_hist_t const * hist, double p)
+/* Returns an upper bound for the p-th percentile
+** (0 < p <= 1) of the samples in hist, or 0 if hist
+** is empty.
+**/
+{
+  uint64_t rank, seen;
+  int i;
+
+  if (hist->count == 0)
+    return 0;
+
+  rank = (uint64_t)(p * (double)hist->count);
+  if (rank == 0)
+    rank = 1;
+
+  seen = 0;
+  for (i = 0; i < LLSTATS_HIST_BUCKETS - 1; i++)
+  {
+    seen += hist->buckets[i];
+    if (seen >= rank)
+      return (i == 0) ? 0 : ((uint64_t)1 << i) - 1;
+  }
+  return hist->max;
+}
+
+/*-----------------------------------*/
+/* Helper Functions                  */ 
+/*-----------------------------------*/
+
+static int
+_llstats_bucket(uint64_t v)
+{
+  int bucket;
+
+  if (v == 0)
+    return 0;
+
+  bucket = 64 - __builtin_clzll(v);
+  return (bucket < LLSTATS_HIST_BUCKETS) ? bucket : LLSTATS_HIST_BUCKETS - 1;
+}
@@ -16,12 +16,12 @@ print(llist_t const * const list)
 
     printf("%s list of size %zu:\n [", order_msg, list->sz);
 
-    llnode_t * cur = list->head;
+    llnode_t * cur = llist_first(list);
     while (cur)
     {
-      printf("%d%s", cur->data, cur->next ? ", " : "");
-      fflush(stdout);
-      cur = cur->next;
+      llnode_t * next = llist_next(list, cur);
+      printf("%d%s", cur->data, next ? ", " : "");
+      cur = next;
     }
     puts("]\n");
   }
@@ -39,11 +39,16 @@ print_node(llnode_t const * const node)
 void
 print_state(llist_t const * const list)
 {
-  if (list)
-    printf("List {\n");
-    printf("  address: %p,\n", list);
-    printf("  head: "); print_node(list->head);
-    printf("  tail: "); print_node(list->tail);
-    printf("  sz: %zu\n", list->sz);
-    printf("}\n");
+  if (!list)
+  {
+    printf("NULL\n");
+    return;
+  }
+
+  printf("List {\n");
+  printf("  address: %p,\n", list);
+  printf("  head: "); print_node(list->head);
+  printf("  tail: "); print_node(list->tail);
+  printf("  sz: %zu\n", list->sz);
+  printf("}\n");
 }
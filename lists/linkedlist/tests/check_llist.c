@@ -1,11 +1,15 @@
 #include <time.h>
 #include <stdio.h>
 #include <check.h>
+#include <limits.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/types.h>
 
 #include "../headers/llist.h"
+#include "../headers/llmap.h"
+#include "../headers/llpack.h"
+#include "../headers/llroar.h"
 #include "../headers/utils.h"
 
 #define handle_error(err, msg)             \
@@ -32,6 +36,9 @@ int tsds_llist_has_llorder(llorder_type_t order);
 void tsds_ck_assert_llist_array_eq(llnode_t * llnode,
                                    int const * const data,
                                    int const sz);
+void tsds_ck_assert_llist_logical_eq(llist_t * llist,
+                                     int const * const data,
+                                     int const sz);
 void tsds_create_nthreads(pthread_t * threads, 
                           tsds_func_t func, 
                           tsds_llarg_t * llargs, 
@@ -148,6 +155,38 @@ tsds_ck_assert_llist_array_eq(llnode_t * llnode,
   }
 }
 
+void
+tsds_ck_assert_llist_logical_eq(llist_t * llist,
+                                int const * const data,
+                                int const sz)
+/* Checks the logical order of llist against data in both
+** directions, along with its size.
+**/
+{
+  llnode_t * llnode;
+  int i;
+
+  ck_assert_uint_eq(llist->sz, sz);
+
+  for (i = 0, llnode = llist_first(llist);
+       llnode;
+       i++, llnode = llist_next(llist, llnode))
+  {
+    ck_assert_int_lt(i, sz);
+    ck_assert_int_eq(llnode->data, data[i]);
+  }
+  ck_assert_int_eq(i, sz);
+
+  for (i = sz - 1, llnode = llist_last(llist);
+       llnode;
+       i--, llnode = llist_prev(llist, llnode))
+  {
+    ck_assert_int_ge(i, 0);
+    ck_assert_int_eq(llnode->data, data[i]);
+  }
+  ck_assert_int_eq(i, -1);
+}
+
 int 
 tsds_llist_has_llorder(llorder_type_t order)
 {
@@ -896,6 +935,1028 @@ START_TEST(test_mt_llist_get)
 }
 END_TEST
 
+START_TEST(test_llist_adaptive_lock)
+/* Tests that a list created with LLIST_ADAPTIVE_LOCK
+** behaves like a default list and exposes lock stats,
+** while default lists report no stats.
+**/
+{
+  adlock_stats_t stats;
+
+  ck_assert_int_eq(llist_lock_stats(llist, &stats), -1);
+  ck_assert_int_eq(llist_lock_stats(NULL, &stats), -1);
+
+  llist_free(llist);
+  llist = llist_create_with_flags(ASC, LLIST_ADAPTIVE_LOCK);
+  ck_assert_int_eq(llist->order, ASC);
+  ck_assert_uint_eq(llist->flags, LLIST_ADAPTIVE_LOCK);
+
+  llist_insert(llist, llnode_create(3));
+  llist_insert(llist, llnode_create(1));
+  llist_insert(llist, llnode_create(2));
+  ck_assert_uint_eq(llist->sz, 3);
+  ck_assert_int_eq(llist_at(llist, 0)->data, 1);
+  ck_assert_int_eq(llist_get(llist, 3)->data, 3);
+
+  llist_delete(llist, 2);
+  ck_assert_uint_eq(llist->sz, 2);
+  ck_assert_ptr_null(llist_get(llist, 2));
+
+  ck_assert_int_eq(llist_lock_stats(llist, &stats), 0);
+  ck_assert_uint_eq(stats.acquires, 7);
+  ck_assert_uint_eq(stats.contended, 0);
+  ck_assert_uint_eq(stats.parks, 0);
+}
+END_TEST
+
+START_TEST(test_llist_doubly_linked)
+/* Tests that a LLIST_DOUBLY_LINKED list flips between
+** ASC and DESC without relinking its nodes, and that
+** inserts, deletes, llist_at(...) and llist_get(...)
+** honor the current direction.
+**/
+{
+  int const data_unordered[] = {16,2,8,32,1,64,4};
+  int const data_asc[] = {1,2,4,8,16,32,64};
+  int const data_desc[] = {64,32,16,8,4,2,1};
+  int const data_desc_ins[] = {64,32,16,10,8,4,2};
+  int const data_asc_ins[] = {2,4,8,10,16,32,64};
+  int const data_none[] = {2,4,8,10,16,32,64,0};
+  int const NUM_LLNODES = 7;
+  llnode_t * head;
+  FILE * file;
+  llist_t * loaded;
+  int i, fd;
+
+  llist_free(llist);
+  llist = llist_create_with_flags(ASC, LLIST_DOUBLY_LINKED);
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_unordered[i]));
+  tsds_ck_assert_llist_logical_eq(llist, data_asc, NUM_LLNODES);
+
+  /* Flip does not touch the links */
+  head = llist->head;
+  llist_change_llorder(llist, DESC);
+  ck_assert_int_eq(llist->order, DESC);
+  ck_assert_ptr_eq(llist->head, head);
+  ck_assert_int_eq(llist->reversed, 1);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc, NUM_LLNODES);
+
+  for (i = 0; i < NUM_LLNODES; i++)
+    ck_assert_int_eq(llist_at(llist, i)->data, data_desc[i]);
+  ck_assert_ptr_null(llist_at(llist, NUM_LLNODES));
+  ck_assert_ptr_eq(llist_get(llist, 64), llist_first(llist));
+
+  /* Writes while reversed */
+  llist_insert(llist, llnode_create(10));
+  llist_delete(llist, 1);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc_ins, NUM_LLNODES);
+
+  /* Snapshots are written in logical order */
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_save(llist, fd), 0);
+  lseek(fd, 0, SEEK_SET);
+  loaded = llist_load(fd);
+  ck_assert_ptr_nonnull(loaded);
+  tsds_ck_assert_llist_array_eq(loaded->head, data_desc_ins, NUM_LLNODES);
+  llist_free(loaded);
+  fclose(file);
+
+  llist_change_llorder(llist, ASC);
+  ck_assert_int_eq(llist->reversed, 0);
+  tsds_ck_assert_llist_logical_eq(llist, data_asc_ins, NUM_LLNODES);
+
+  /* NONE keeps the current sequence and appends */
+  llist_change_llorder(llist, DESC);
+  llist_change_llorder(llist, NONE);
+  llist_change_llorder(llist, NONE);
+  ck_assert_int_eq(llist->reversed, 1);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc_ins, NUM_LLNODES);
+  llist_change_llorder(llist, ASC);
+  ck_assert_int_eq(llist->reversed, 0);
+  llist_change_llorder(llist, NONE);
+  llist_insert(llist, llnode_create(0));
+  tsds_ck_assert_llist_logical_eq(llist, data_none, NUM_LLNODES + 1);
+
+  /* Default lists still relink on a flip */
+  llist_free(llist);
+  llist = llist_create_with_llorder(ASC);
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_unordered[i]));
+  llist_change_llorder(llist, DESC);
+  ck_assert_int_eq(llist->reversed, 0);
+  tsds_ck_assert_llist_array_eq(llist->head, data_desc, NUM_LLNODES);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc, NUM_LLNODES);
+}
+END_TEST
+
+START_TEST(test_llist_lazy_sort)
+/* Tests that a LLIST_LAZY_SORT list defers order changes
+** and buffers inserts until an order-dependent read, and
+** that the merged result matches an eagerly sorted list.
+**/
+{
+  int const data_unordered[] = {16,2,8,32,1,64,4};
+  int const data_asc[] = {1,2,4,8,16,32,64};
+  int const data_desc_ins[] = {64,32,16,10,8,4,3,2};
+  int const data_asc_ins[] = {2,3,4,5,8,10,16,32,64};
+  int const data_extremes[] = {INT_MIN,-7,-5,INT_MAX};
+  int const NUM_LLNODES = 7;
+  llnode_t * head;
+  int i;
+
+  llist_free(llist);
+  llist = llist_create_with_flags(NONE, LLIST_LAZY_SORT);
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_unordered[i]));
+
+  /* Only the intent is recorded */
+  head = llist->head;
+  llist_change_llorder(llist, ASC);
+  ck_assert_int_eq(llist->order, ASC);
+  ck_assert_ptr_eq(llist->head, head);
+  tsds_ck_assert_llist_array_eq(llist->head, data_unordered, NUM_LLNODES);
+
+  /* First ordered read sorts */
+  ck_assert_int_eq(llist_at(llist, 0)->data, 1);
+  tsds_ck_assert_llist_logical_eq(llist, data_asc, NUM_LLNODES);
+
+  /* Inserts are buffered at the tail while a flip is pending */
+  llist_change_llorder(llist, DESC);
+  llist_insert(llist, llnode_create(10));
+  llist_insert(llist, llnode_create(3));
+  ck_assert_int_eq(llist->tail->data, 3);
+  llist_delete(llist, 1);
+  ck_assert_ptr_nonnull(llist_get(llist, 10));
+  ck_assert_uint_eq(llist->sz, NUM_LLNODES + 1);
+
+  llist_apply_order(llist);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc_ins, NUM_LLNODES + 1);
+
+  /* Sorted lists insert in place */
+  llist_insert(llist, llnode_create(5));
+  llist_change_llorder(llist, ASC);
+  llist_change_llorder(llist, DESC);
+  llist_change_llorder(llist, ASC);
+  for (i = 0; i < NUM_LLNODES + 2; i++)
+    ck_assert_int_eq(llist_at(llist, i)->data, data_asc_ins[i]);
+  tsds_ck_assert_llist_logical_eq(llist, data_asc_ins, NUM_LLNODES + 2);
+
+  /* Extreme values merge without overflowing comparisons */
+  llist_free(llist);
+  llist = llist_create_with_flags(DESC, LLIST_LAZY_SORT);
+  llist_insert(llist, llnode_create(-5));
+  llist_insert(llist, llnode_create(-7));
+  llist_change_llorder(llist, ASC);
+  llist_insert(llist, llnode_create(INT_MAX));
+  llist_insert(llist, llnode_create(INT_MIN));
+  llist_apply_order(llist);
+  tsds_ck_assert_llist_logical_eq(llist, data_extremes, 4);
+}
+END_TEST
+
+START_TEST(test_llist_insert_finger)
+/* Tests that ordered inserts stay sorted and stable when
+** they append at either end or start from the finger,
+** including after the finger llnode is deleted.
+**/
+{
+  int const data_nearly[] = {1,2,4,3,5,7,6,8,0,9,9};
+  int const data_asc[] = {0,1,2,3,4,5,6,7,8,9,9};
+  int const data_desc[] = {9,9,8,7,6,5,4,3,2,1,0};
+  int const data_asc_del[] = {0,1,2,3,4,5,5,6,8,9,9};
+  int const NUM_LLNODES = 11;
+  llnode_t * first_nine;
+  int i;
+
+  llist_change_llorder(llist, ASC);
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_nearly[i]));
+  tsds_ck_assert_llist_logical_eq(llist, data_asc, NUM_LLNODES);
+
+  /* Equal values go after the ones already present */
+  first_nine = llist_get(llist, 9);
+  ck_assert_ptr_eq(first_nine->next, llist->tail);
+
+  /* Finger moves to its predecessor when deleted */
+  llist_delete(llist, 7);
+  llist_insert(llist, llnode_create(5));
+  tsds_ck_assert_llist_logical_eq(llist, data_asc_del, NUM_LLNODES);
+  ck_assert_int_eq(llist->finger->data, 5);
+  ck_assert_int_eq(llist->finger->prev->data, 5);
+  llist_delete(llist, 5);
+  llist_delete(llist, 5);
+  ck_assert_int_eq(llist->finger->data, 4);
+  llist_insert(llist, llnode_create(5));
+  llist_insert(llist, llnode_create(7));
+  tsds_ck_assert_llist_logical_eq(llist, data_asc, NUM_LLNODES);
+
+  llist_free(llist);
+  llist = llist_create_with_llorder(DESC);
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_nearly[i]));
+  tsds_ck_assert_llist_logical_eq(llist, data_desc, NUM_LLNODES);
+}
+END_TEST
+
+START_TEST(test_llist_range)
+/* Tests range counts, sums, copies and min/max on ASC,
+** DESC, doubly linked and unordered lists.
+**/
+{
+  int const data_unordered[] = {16,2,8,32,1,64,4,8};
+  int const data_range[] = {4,8,8,16};
+  int const NUM_LLNODES = 8;
+  int out[8];
+  unsigned int flags[] = {LLIST_DEFAULT, LLIST_DOUBLY_LINKED};
+  llorder_type_t orders[] = {ASC, DESC, NONE};
+  int i, f, o;
+
+  ck_assert_uint_eq(llist_range_count(NULL, 0, 1), 0);
+  ck_assert_ptr_null(llist_min(llist));
+  ck_assert_ptr_null(llist_max(llist));
+
+  for (f = 0; f < 2; f++)
+    for (o = 0; o < 3; o++)
+    {
+      llist_free(llist);
+      llist = llist_create_with_flags(ASC, flags[f]);
+      for (i = 0; i < NUM_LLNODES; i++)
+        llist_insert(llist, llnode_create(data_unordered[i]));
+      llist_change_llorder(llist, orders[o]);
+
+      ck_assert_int_eq(llist_min(llist)->data, 1);
+      ck_assert_int_eq(llist_max(llist)->data, 64);
+
+      ck_assert_uint_eq(llist_range_count(llist, 3, 20), 4);
+      ck_assert_uint_eq(llist_range_count(llist, 0, 100), NUM_LLNODES);
+      ck_assert_uint_eq(llist_range_count(llist, 65, 100), 0);
+      ck_assert_uint_eq(llist_range_count(llist, 20, 3), 0);
+      ck_assert_int_eq(llist_range_sum(llist, 3, 20), 36);
+      ck_assert_int_eq(llist_range_sum(llist, 64, 64), 64);
+
+      ck_assert_uint_eq(llist_range_copy(llist, 3, 20, out, 8), 4);
+      for (i = 0; i < 4; i++)
+        ck_assert_int_eq(out[i], data_range[i]);
+      ck_assert_uint_eq(llist_range_copy(llist, 3, 20, out, 2), 2);
+      ck_assert_int_eq(out[1], data_range[1]);
+      ck_assert_uint_eq(llist_range_copy(llist, 3, 20, NULL, 8), 0);
+    }
+}
+END_TEST
+
+START_TEST(test_llist_set_ops)
+/* Tests union, intersection and difference of ordered
+** lists with duplicates, in copy and move mode, and
+** between lists using different locks.
+**/
+{
+  int const data_a[] = {1,2,2,4,6,8,8};
+  int const data_b[] = {9,8,5,4,2};
+  int const data_union[] = {1,2,2,4,5,6,8,8,9};
+  int const data_inter[] = {2,4,8};
+  int const data_diff[] = {1,2,6,8};
+  int const data_diff_desc[] = {8,6,2,1};
+  int const data_a_left[] = {2,4,8};
+  int const NUM_A = 7;
+  int const NUM_B = 5;
+  llist_t * b;
+  llist_t * res;
+  int i;
+
+  llist_change_llorder(llist, ASC);
+  b = llist_create_with_flags(DESC, LLIST_ADAPTIVE_LOCK);
+  for (i = 0; i < NUM_A; i++)
+    llist_insert(llist, llnode_create(data_a[i]));
+  for (i = 0; i < NUM_B; i++)
+    llist_insert(b, llnode_create(data_b[i]));
+
+  ck_assert_ptr_null(llist_union(llist, NULL, LLIST_SET_COPY));
+
+  res = llist_union(llist, b, LLIST_SET_COPY);
+  ck_assert_int_eq(res->order, ASC);
+  tsds_ck_assert_llist_logical_eq(res, data_union, 9);
+  llist_free(res);
+
+  res = llist_intersect(b, llist, LLIST_SET_COPY);
+  ck_assert_int_eq(res->order, DESC);
+  ck_assert_uint_eq(res->sz, 3);
+  ck_assert_int_eq(res->head->data, 8);
+  llist_free(res);
+
+  res = llist_intersect(llist, b, LLIST_SET_COPY);
+  tsds_ck_assert_llist_logical_eq(res, data_inter, 3);
+  llist_free(res);
+
+  res = llist_difference(llist, llist, LLIST_SET_MOVE);
+  ck_assert_uint_eq(res->sz, 0);
+  ck_assert_uint_eq(llist->sz, NUM_A);
+  llist_free(res);
+
+  /* Moved llnodes leave their inputs */
+  res = llist_difference(llist, b, LLIST_SET_MOVE);
+  tsds_ck_assert_llist_logical_eq(res, data_diff, 4);
+  tsds_ck_assert_llist_logical_eq(llist, data_a_left, 3);
+  ck_assert_uint_eq(b->sz, NUM_B);
+
+  llist_change_llorder(res, DESC);
+  tsds_ck_assert_llist_logical_eq(res, data_diff_desc, 4);
+  llist_free(llist);
+  llist = llist_union(res, b, LLIST_SET_MOVE);
+  ck_assert_uint_eq(llist->sz, 7);
+  ck_assert_uint_eq(res->sz, 0);
+  ck_assert_uint_eq(b->sz, 2);
+  ck_assert_int_eq(b->head->data, 8);
+  ck_assert_int_eq(llist->head->data, 9);
+  llist_free(res);
+
+  res = llist_difference(llist, b, LLIST_SET_COPY);
+  ck_assert_uint_eq(res->sz, 5);
+  llist_free(res);
+
+  llist_free(b);
+  b = llist_create_with_llorder(DESC);
+  res = llist_difference(llist, b, LLIST_SET_COPY);
+  ck_assert_uint_eq(res->sz, 7);
+  llist_free(res);
+
+  llist_change_llorder(b, NONE);
+  ck_assert_ptr_null(llist_intersect(llist, b, LLIST_SET_COPY));
+  llist_free(b);
+}
+END_TEST
+
+START_TEST(test_llist_concat_split)
+/* Tests that concat and the splits move llnodes between
+** lists, keep sizes right and preserve logical order for
+** unordered, ordered and reversed lists.
+**/
+{
+  int const data_a[] = {5,1,3};
+  int const data_b[] = {4,2,6};
+  int const data_none[] = {5,1,3,4,2,6};
+  int const data_desc[] = {6,5,4,3,2,1};
+  int const data_hi[] = {6,5,4};
+  int const data_lo[] = {3,2,1};
+  int const data_none_hi[] = {5,4,6};
+  int const data_none_lo[] = {1,3,2};
+  int const data_mixed[] = {7,6,5,4,3,2,1};
+  llist_t * b;
+  llist_t * res;
+  int i;
+
+  b = llist_create_with_flags(NONE, LLIST_ADAPTIVE_LOCK);
+  for (i = 0; i < 3; i++)
+  {
+    llist_insert(llist, llnode_create(data_a[i]));
+    llist_insert(b, llnode_create(data_b[i]));
+  }
+
+  llist_concat(llist, llist);
+  llist_concat(llist, b);
+  tsds_ck_assert_llist_logical_eq(llist, data_none, 6);
+  ck_assert_uint_eq(b->sz, 0);
+  ck_assert_ptr_null(b->head);
+  ck_assert_ptr_null(b->tail);
+
+  /* Unordered splits keep relative order */
+  res = llist_split_by_value(llist, 4);
+  tsds_ck_assert_llist_logical_eq(res, data_none_hi, 3);
+  tsds_ck_assert_llist_logical_eq(llist, data_none_lo, 3);
+
+  /* Ordered concat merges */
+  llist_change_llorder(llist, DESC);
+  llist_concat(llist, res);
+  llist_free(res);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc, 6);
+
+  ck_assert_ptr_null(llist_split_at(llist, 7));
+  res = llist_split_at(llist, 3);
+  ck_assert_int_eq(res->order, DESC);
+  tsds_ck_assert_llist_logical_eq(res, data_lo, 3);
+  tsds_ck_assert_llist_logical_eq(llist, data_hi, 3);
+  llist_concat(llist, res);
+  llist_free(res);
+
+  res = llist_split_by_value(llist, 4);
+  tsds_ck_assert_llist_logical_eq(res, data_hi, 3);
+  tsds_ck_assert_llist_logical_eq(llist, data_lo, 3);
+  llist_concat(res, llist);
+  tsds_ck_assert_llist_logical_eq(res, data_desc, 6);
+  llist_free(res);
+
+  /* Reversed doubly linked lists */
+  llist_free(llist);
+  llist = llist_create_with_flags(ASC, LLIST_DOUBLY_LINKED);
+  for (i = 1; i <= 6; i++)
+    llist_insert(llist, llnode_create(i));
+  llist_change_llorder(llist, DESC);
+  llist_change_llorder(llist, NONE);
+  ck_assert_int_eq(llist->reversed, 1);
+
+  res = llist_split_at(llist, 0);
+  tsds_ck_assert_llist_logical_eq(res, data_desc, 6);
+  ck_assert_uint_eq(llist->sz, 0);
+  llist_free(b);
+  b = llist_split_at(res, 3);
+  ck_assert_int_eq(b->reversed, 1);
+  tsds_ck_assert_llist_logical_eq(b, data_lo, 3);
+  tsds_ck_assert_llist_logical_eq(res, data_hi, 3);
+
+  /* Mixed directions */
+  llist_concat(res, b);
+  llist_free(b);
+  b = llist_create();
+  llist_insert(b, llnode_create(7));
+  llist_concat(b, res);
+  ck_assert_int_eq(b->reversed, 0);
+  tsds_ck_assert_llist_logical_eq(b, data_mixed, 7);
+  llist_concat(llist, b);
+  ck_assert_int_eq(llist->reversed, 1);
+  tsds_ck_assert_llist_logical_eq(llist, data_mixed, 7);
+
+  llist_free(res);
+  llist_free(b);
+}
+END_TEST
+
+START_TEST(test_llist_array_dump)
+/* Tests llist_to_array(...), llist_from_array(...) and
+** both llist_dump(...) formats.
+**/
+{
+  int const data_unordered[] = {16,2,8,32,-2147483647 - 1,64,4};
+  int const data_desc[] = {64,32,16,8,4,2,-2147483647 - 1};
+  char const text_desc[] = "64\n32\n16\n8\n4\n2\n-2147483648\n";
+  int const NUM_LLNODES = 7;
+  int out[7];
+  int32_t raw[8];
+  char text[64];
+  FILE * file;
+  int fd;
+
+  ck_assert_ptr_null(llist_from_array(ASC, NULL, 1));
+  llist_free(llist);
+  llist = llist_from_array(DESC, NULL, 0);
+  ck_assert_uint_eq(llist->sz, 0);
+  ck_assert_uint_eq(llist_to_array(llist, out, NUM_LLNODES), 0);
+
+  llist_free(llist);
+  llist = llist_from_array(DESC, data_unordered, NUM_LLNODES);
+  tsds_ck_assert_llist_logical_eq(llist, data_desc, NUM_LLNODES);
+  llist_insert(llist, llnode_create(0));
+  llist_delete(llist, 0);
+
+  ck_assert_uint_eq(llist_to_array(llist, out, NUM_LLNODES), NUM_LLNODES);
+  ck_assert_int_eq(memcmp(out, data_desc, sizeof(out)), 0);
+  ck_assert_uint_eq(llist_to_array(llist, out, 2), 2);
+  ck_assert_uint_eq(llist_to_array(llist, NULL, 2), 0);
+
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_dump(llist, fd, LLIST_DUMP_TEXT), 0);
+  ck_assert_int_eq(pread(fd, text, sizeof(text), 0), sizeof(text_desc) - 1);
+  ck_assert_int_eq(memcmp(text, text_desc, sizeof(text_desc) - 1), 0);
+  fclose(file);
+
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_dump(llist, fd, LLIST_DUMP_BINARY), 0);
+  ck_assert_int_eq(pread(fd, raw, sizeof(raw), 0), NUM_LLNODES * sizeof(int32_t));
+  ck_assert_int_eq(raw[0], 64);
+  ck_assert_int_eq(raw[6], -2147483647 - 1);
+  fclose(file);
+
+  ck_assert_int_eq(llist_dump(NULL, fd, LLIST_DUMP_TEXT), -1);
+}
+END_TEST
+
+START_TEST(test_llist_unique)
+/* Tests that LLIST_UNIQUE lists of every order keep one
+** llnode per value through inserts and concats, and hand
+** back the existing llnode.
+**/
+{
+  int const data_unordered[] = {16,2,8,2,16,1,8};
+  int const data_asc[] = {1,2,8,16};
+  int const data_none[] = {16,2,8,1};
+  int const data_concat[] = {8,32,32,1,4};
+  int const data_concat_res[3][6] = {{1,2,4,8,16,32},
+                                     {32,16,8,4,2,1},
+                                     {16,2,8,1,32,4}};
+  llorder_type_t orders[] = {ASC, DESC, NONE};
+  llist_t * src;
+  llnode_t * llnode;
+  int i, o;
+
+  for (o = 0; o < 3; o++)
+  {
+    llist_free(llist);
+    llist = llist_create_with_flags(orders[o], LLIST_UNIQUE | LLIST_DOUBLY_LINKED);
+    for (i = 0; i < 7; i++)
+      llist_insert(llist, llnode_create(data_unordered[i]));
+    ck_assert_uint_eq(llist->sz, 4);
+
+    llnode = llist_get(llist, 8);
+    ck_assert_ptr_eq(llist_insert_node(llist, llnode_create(8)), llnode);
+    ck_assert_int_eq(llist_insert(llist, llnode_create(8)), 1);
+    ck_assert_ptr_eq(llist_insert_value(llist, 8), llnode);
+    ck_assert_uint_eq(llist->sz, 4);
+
+    llnode = llist_insert_value(llist, 4);
+    ck_assert_int_eq(llnode->data, 4);
+    ck_assert_ptr_eq(llist_get(llist, 4), llnode);
+    ck_assert_uint_eq(llist->sz, 5);
+    llist_delete(llist, 4);
+  }
+  tsds_ck_assert_llist_logical_eq(llist, data_none, 4);
+
+  /* Concats drop values dst already holds, including
+     values repeated within src */
+  for (o = 0; o < 3; o++)
+  {
+    llist_free(llist);
+    llist = llist_create_with_flags(orders[o], LLIST_UNIQUE);
+    for (i = 0; i < 7; i++)
+      llist_insert(llist, llnode_create(data_unordered[i]));
+    src = llist_from_array(NONE, data_concat, 5);
+    llist_concat(llist, src);
+    ck_assert_uint_eq(src->sz, 0);
+    llist_free(src);
+    tsds_ck_assert_llist_logical_eq(llist, data_concat_res[o], 6);
+  }
+
+  /* Values buffered by a pending lazy sort are checked too */
+  llist_free(llist);
+  llist = llist_create_with_flags(NONE, LLIST_UNIQUE | LLIST_LAZY_SORT);
+  llist_change_llorder(llist, ASC);
+  for (i = 0; i < 7; i++)
+    llist_insert_value(llist, data_unordered[i]);
+  llist_apply_order(llist);
+  tsds_ck_assert_llist_logical_eq(llist, data_asc, 4);
+
+  /* Default lists still keep duplicates */
+  llist_free(llist);
+  llist = llist_create_with_llorder(ASC);
+  llnode = llist_insert_value(llist, 1);
+  ck_assert_ptr_ne(llist_insert_value(llist, 1), llnode);
+  ck_assert_int_eq(llist_insert(llist, llnode_create(1)), 0);
+  ck_assert_uint_eq(llist->sz, 3);
+}
+END_TEST
+
+START_TEST(test_llist_save_load)
+/* Tests that llist_load(...) restores the order, size
+** and elements of a list written with llist_save(...)
+** and rejects malformed snapshots.
+**/
+{
+  int const data_desc[] = {64,32,16,8,4,2,1};
+  int const data_unordered[] = {16,2,8,32,1,64,4};
+  int const NUM_LLNODES = 7;
+  llist_t * loaded;
+  FILE * file;
+  int fd, i;
+
+  for (i = 0; i < NUM_LLNODES; i++)
+    llist_insert(llist, llnode_create(data_unordered[i]));
+
+  /* Unordered list keeps its element order */
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_save(llist, fd), 0);
+  lseek(fd, 0, SEEK_SET);
+  loaded = llist_load(fd);
+  ck_assert_ptr_nonnull(loaded);
+  ck_assert_int_eq(loaded->order, NONE);
+  ck_assert_uint_eq(loaded->sz, NUM_LLNODES);
+  ck_assert_int_eq(loaded->tail->data, 4);
+  ck_assert_ptr_null(loaded->tail->next);
+  tsds_ck_assert_llist_array_eq(loaded->head, data_unordered, NUM_LLNODES);
+  llist_free(loaded);
+  fclose(file);
+
+  /* Ordered list keeps its order */
+  llist_change_llorder(llist, DESC);
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_save(llist, fd), 0);
+  lseek(fd, 0, SEEK_SET);
+  loaded = llist_load(fd);
+  ck_assert_ptr_nonnull(loaded);
+  ck_assert_int_eq(loaded->order, DESC);
+  ck_assert_uint_eq(loaded->sz, NUM_LLNODES);
+  tsds_ck_assert_llist_array_eq(loaded->head, data_desc, NUM_LLNODES);
+
+  /* Loaded list is fully usable */
+  llist_insert(loaded, llnode_create(10));
+  ck_assert_int_eq(llist_at(loaded, 3)->data, 10);
+  llist_free(loaded);
+  fclose(file);
+
+  /* Edge cases:
+  **  1. empty list
+  **  2. truncated snapshot
+  **  3. bad magic
+  ***/
+  llist_free(llist);
+  llist = llist_create_with_llorder(ASC);
+
+  /* Edge case 1 */
+  file = tmpfile();
+  fd = fileno(file);
+  ck_assert_int_eq(llist_save(llist, fd), 0);
+  lseek(fd, 0, SEEK_SET);
+  loaded = llist_load(fd);
+  ck_assert_ptr_nonnull(loaded);
+  ck_assert_uint_eq(loaded->sz, 0);
+  ck_assert_ptr_null(loaded->head);
+  ck_assert_ptr_null(loaded->tail);
+  llist_free(loaded);
+
+  /* Edge case 2 */
+  llist_insert(llist, llnode_create(1));
+  lseek(fd, 0, SEEK_SET);
+  ck_assert_int_eq(llist_save(llist, fd), 0);
+  ck_assert_int_eq(ftruncate(fd, lseek(fd, 0, SEEK_CUR) - 1), 0);
+  lseek(fd, 0, SEEK_SET);
+  ck_assert_ptr_null(llist_load(fd));
+
+  /* Edge case 3 */
+  lseek(fd, 0, SEEK_SET);
+  ck_assert_int_eq(write(fd, "XXXX", 4), 4);
+  lseek(fd, 0, SEEK_SET);
+  ck_assert_ptr_null(llist_load(fd));
+  fclose(file);
+
+  ck_assert_int_eq(llist_save(NULL, fd), -1);
+  ck_assert_ptr_null(llist_load(-1));
+}
+END_TEST
+
+START_TEST(test_llmap)
+/* Tests that a list written with llmap_write(...) can
+** be queried in place after llmap_open(...), that the
+** overlay merges with mapped values in list order, that
+** llmap_compact(...) persists the merged list and that
+** looping offsets do not hang walks.
+**/
+{
+  int const data_asc[] = {1,2,4,8,16,32,64};
+  int const data_merged[] = {1,3,4,8,16,32,64,100};
+  int const NUM_LLNODES = 7;
+  char path[] = "/tmp/tsds_llmap_XXXXXX";
+  char compact_path[] = "/tmp/tsds_llmap_XXXXXX";
+  llmap_iter_t it;
+  llmap_t * map;
+  uint64_t head;
+  FILE * fp;
+  int i, data;
+
+  close(mkstemp(path));
+  close(mkstemp(compact_path));
+
+  llist_change_llorder(llist, ASC);
+  for (i = NUM_LLNODES - 1; i >= 0; i--)
+    llist_insert(llist, llnode_create(data_asc[i]));
+  ck_assert_int_eq(llmap_write(llist, path), 0);
+
+  map = llmap_open(path);
+  ck_assert_ptr_nonnull(map);
+  ck_assert_int_eq(map->order, ASC);
+  ck_assert_uint_eq(map->sz, NUM_LLNODES);
+
+  for (i = 0; i < NUM_LLNODES; i++)
+  {
+    ck_assert_int_eq(llmap_contains(map, data_asc[i]), 1);
+    ck_assert_int_eq(llmap_at(map, i, &data), 0);
+    ck_assert_int_eq(data, data_asc[i]);
+  }
+  ck_assert_int_eq(llmap_contains(map, 3), 0);
+  ck_assert_int_eq(llmap_at(map, NUM_LLNODES, &data), -1);
+
+  /* Overlay inserts and private deletes */
+  llmap_insert(map, 100);
+  llmap_insert(map, 3);
+  ck_assert_int_eq(llmap_delete(map, 2), 0);
+  ck_assert_int_eq(llmap_delete(map, 2), -1);
+  ck_assert_uint_eq(map->sz, 8);
+  ck_assert_int_eq(llmap_contains(map, 3), 1);
+  ck_assert_int_eq(llmap_contains(map, 2), 0);
+
+  i = 0;
+  llmap_iter_begin(map, &it);
+  while (llmap_iter_next(&it, &data))
+    ck_assert_int_eq(data, data_merged[i++]);
+  llmap_iter_end(&it);
+  ck_assert_int_eq(i, 8);
+
+  ck_assert_int_eq(llmap_compact(map, compact_path), 0);
+  llmap_close(map);
+
+  /* File itself was never modified */
+  map = llmap_open(path);
+  ck_assert_ptr_nonnull(map);
+  ck_assert_uint_eq(map->sz, NUM_LLNODES);
+  ck_assert_int_eq(llmap_contains(map, 2), 1);
+  llmap_close(map);
+
+  map = llmap_open(compact_path);
+  ck_assert_ptr_nonnull(map);
+  ck_assert_uint_eq(map->sz, 8);
+  for (i = 0; i < 8; i++)
+  {
+    ck_assert_int_eq(llmap_at(map, i, &data), 0);
+    ck_assert_int_eq(data, data_merged[i]);
+  }
+  llmap_close(map);
+
+  /* Last node's next, the end of the file, points back at
+     the head, so walks must stop after the node count */
+  map = llmap_open(path);
+  ck_assert_ptr_nonnull(map);
+  head = map->head;
+  fp = fopen(path, "r+b");
+  ck_assert_ptr_nonnull(fp);
+  ck_assert_int_eq(fseek(fp, (long)(map->len - sizeof(head)), SEEK_SET), 0);
+  ck_assert_uint_eq(fwrite(&head, sizeof(head), 1, fp), 1);
+  ck_assert_int_eq(fflush(fp), 0);
+  fclose(fp);
+  llmap_close(map);
+
+  map = llmap_open(path);
+  ck_assert_ptr_nonnull(map);
+  ck_assert_int_eq(llmap_contains(map, 100), 0);
+  ck_assert_int_eq(llmap_delete(map, 100), -1);
+  ck_assert_int_eq(llmap_at(map, NUM_LLNODES - 1, &data), 0);
+  ck_assert_int_eq(data, data_asc[NUM_LLNODES - 1]);
+
+  i = 0;
+  llmap_iter_begin(map, &it);
+  while (llmap_iter_next(&it, &data))
+    ck_assert_int_eq(data, data_asc[i++]);
+  ck_assert_int_eq(llmap_iter_next(&it, &data), 0);
+  llmap_iter_end(&it);
+  ck_assert_int_eq(i, NUM_LLNODES);
+  llmap_close(map);
+
+  /* Edge cases:
+  **  1. not a map file
+  **  2. missing file
+  ***/
+  ck_assert_int_eq(truncate(path, 4), 0);
+  ck_assert_ptr_null(llmap_open(path));
+  unlink(path);
+  unlink(compact_path);
+  ck_assert_ptr_null(llmap_open(path));
+}
+END_TEST
+
+START_TEST(test_llpack)
+/* Tests that a pack built from a list or by inserts
+** matches the list through block splits, deletes,
+** positional access and range scans.
+**/
+{
+  int const NUM_VALUES = 1000;
+  int out[8];
+  llpack_t * pack;
+  llpack_t * desc;
+  int i, data;
+
+  ck_assert_ptr_null(llpack_create(NONE));
+  ck_assert_ptr_null(llpack_from_llist(llist));
+
+  /* Wide gaps and negative values need multi-byte varints */
+  llist_change_llorder(llist, ASC);
+  pack = llpack_create(ASC);
+  for (i = 0; i < NUM_VALUES; i++)
+  {
+    data = (i * 7919) % NUM_VALUES * 100000 - 50000000;
+    llist_insert(llist, llnode_create(data));
+    ck_assert_int_eq(llpack_insert(pack, data), 0);
+  }
+  ck_assert_int_eq(llpack_insert(pack, 1), 0);
+  ck_assert_int_eq(llpack_insert(pack, 1), 0);
+  ck_assert_uint_eq(pack->sz, NUM_VALUES + 2);
+  ck_assert_uint_gt(pack->num_blocks, NUM_VALUES / LLPACK_BLOCK_VALUES);
+
+  for (i = 0; i < NUM_VALUES; i++)
+  {
+    ck_assert_int_eq(llpack_at(pack, i + (i > 500 ? 2 : 0), &data), 0);
+    ck_assert_int_eq(data, llist_at(llist, i)->data);
+  }
+  ck_assert_int_eq(llpack_at(pack, NUM_VALUES + 2, &data), -1);
+
+  ck_assert_int_eq(llpack_delete(pack, 1), 1);
+  ck_assert_int_eq(llpack_contains(pack, 1), 1);
+  ck_assert_int_eq(llpack_delete(pack, 1), 1);
+  ck_assert_int_eq(llpack_contains(pack, 1), 0);
+  ck_assert_int_eq(llpack_delete(pack, 1), 0);
+  ck_assert_int_eq(llpack_contains(pack, 0), 1);
+  ck_assert_int_eq(llpack_contains(pack, -50000000), 1);
+  ck_assert_int_eq(llpack_contains(pack, -49999999), 0);
+  ck_assert_int_eq(llpack_contains(pack, 49900000), 1);
+  ck_assert_int_eq(llpack_contains(pack, 49900001), 0);
+
+  ck_assert_uint_eq(llpack_range_count(pack, -200, 300000),
+                    llist_range_count(llist, -200, 300000));
+  ck_assert_int_eq(llpack_range_sum(pack, -30000000, 30000000),
+                   llist_range_sum(llist, -30000000, 30000000));
+  ck_assert_uint_eq(llpack_range_copy(pack, 0, 1000000, out, 8), 8);
+  ck_assert_int_eq(out[7], 700000);
+
+  /* Built in bulk from a DESC list */
+  llist_change_llorder(llist, DESC);
+  desc = llpack_from_llist(llist);
+  ck_assert_uint_eq(desc->sz, NUM_VALUES);
+  ck_assert_uint_eq(desc->num_blocks, (NUM_VALUES + LLPACK_BLOCK_VALUES - 1) / LLPACK_BLOCK_VALUES);
+  ck_assert_uint_lt(llpack_bytes(desc), NUM_VALUES * sizeof(llnode_t) / 4);
+  for (i = 0; i < NUM_VALUES; i += 37)
+  {
+    ck_assert_int_eq(llpack_at(desc, i, &data), 0);
+    ck_assert_int_eq(data, llist_at(llist, i)->data);
+  }
+
+  for (i = 0; i < NUM_VALUES; i++)
+    ck_assert_int_eq(llpack_delete(desc, llist_at(llist, i)->data), 1);
+  ck_assert_uint_eq(desc->sz, 0);
+  ck_assert_uint_eq(desc->num_blocks, 0);
+
+  llpack_free(desc);
+  llpack_free(pack);
+}
+END_TEST
+
+START_TEST(test_llroar)
+/* Tests array, bitmap and run containers through their
+** conversions, positional access, set algebra and the
+** conversion from a pointer-based list.
+**/
+{
+  int const NUM_DENSE = 10000;
+  int out[4];
+  llroar_t * evens;
+  llroar_t * dense;
+  llroar_t * res;
+  int i, data;
+
+  /* Sparse values spread over several containers,
+     including negative ones */
+  evens = llroar_create();
+  for (i = -2 * NUM_DENSE; i < 2 * NUM_DENSE; i += 2)
+    ck_assert_int_eq(llroar_insert(evens, i), 1);
+  ck_assert_int_eq(llroar_insert(evens, 0), 0);
+  ck_assert_uint_eq(evens->sz, 2 * NUM_DENSE);
+  ck_assert_int_eq(llroar_contains(evens, -2 * NUM_DENSE), 1);
+  ck_assert_int_eq(llroar_contains(evens, 1), 0);
+  ck_assert_int_eq(llroar_at(evens, 0, &data), 0);
+  ck_assert_int_eq(data, -2 * NUM_DENSE);
+  ck_assert_int_eq(llroar_at(evens, NUM_DENSE, &data), 0);
+  ck_assert_int_eq(data, 0);
+  ck_assert_int_eq(llroar_at(evens, 2 * NUM_DENSE, &data), -1);
+
+  /* A dense range: array -> bitmap -> runs */
+  llist_change_llorder(llist, DESC);
+  for (i = 0; i < NUM_DENSE; i++)
+    llist_insert(llist, llnode_create(i % 5000 == 4999 ? 0 : i));
+  dense = llroar_from_llist(llist);
+  ck_assert_uint_eq(dense->sz, NUM_DENSE - 2);
+  ck_assert_uint_eq(dense->num_containers, 1);
+  ck_assert_int_eq(dense->containers[0].type, LLROAR_RUN);
+  ck_assert_uint_lt(llroar_bytes(dense), 256);
+  ck_assert_int_eq(llroar_contains(dense, 4999), 0);
+  ck_assert_int_eq(llroar_contains(dense, 5000), 1);
+  ck_assert_int_eq(llroar_at(dense, 4999, &data), 0);
+  ck_assert_int_eq(data, 5000);
+
+  ck_assert_int_eq(llroar_delete(dense, 5000), 1);
+  ck_assert_int_eq(dense->containers[0].type, LLROAR_BITMAP);
+  ck_assert_int_eq(llroar_delete(dense, 5000), 0);
+  for (i = 0; i < NUM_DENSE - LLROAR_ARRAY_MAX; i++)
+    llroar_delete(dense, i);
+  ck_assert_int_eq(dense->containers[0].type, LLROAR_ARRAY);
+  for (i = 0; i < NUM_DENSE; i++)
+    llroar_insert(dense, i);
+  ck_assert_int_eq(dense->containers[0].type, LLROAR_BITMAP);
+  ck_assert_uint_eq(dense->sz, NUM_DENSE);
+
+  /* Set algebra across container kinds */
+  res = llroar_and(evens, dense);
+  ck_assert_uint_eq(res->sz, NUM_DENSE / 2);
+  ck_assert_uint_eq(llroar_to_array(res, out, 4), 4);
+  ck_assert_int_eq(out[3], 6);
+  llroar_free(res);
+
+  res = llroar_or(evens, dense);
+  ck_assert_uint_eq(res->sz, 2 * NUM_DENSE + NUM_DENSE / 2);
+  llroar_free(res);
+
+  res = llroar_andnot(dense, evens);
+  ck_assert_uint_eq(res->sz, NUM_DENSE / 2);
+  ck_assert_int_eq(llroar_contains(res, 1), 1);
+  ck_assert_int_eq(llroar_contains(res, 2), 0);
+  llroar_free(res);
+
+  res = llroar_andnot(evens, evens);
+  ck_assert_uint_eq(res->sz, 0);
+  ck_assert_uint_eq(res->num_containers, 0);
+  llroar_free(res);
+
+  llroar_free(dense);
+  llroar_free(evens);
+}
+END_TEST
+
+START_TEST(test_llist_stats)
+/* Tests that llist_stats(...) counts operations and
+** traversal lengths when built with TSDS_STATS and
+** reports that stats are unavailable otherwise.
+**/
+{
+  llist_stats_t stats;
+
+  llist_change_llorder(llist, ASC);
+  llist_insert(llist, llnode_create(1));
+  llist_insert(llist, llnode_create(2));
+  llist_insert(llist, llnode_create(3));
+  llist_get(llist, 3);
+  llist_at(llist, 1);
+  llist_delete(llist, 1);
+
+#ifdef TSDS_STATS
+  ck_assert_int_eq(llist_stats(llist, &stats), 0);
+  ck_assert_uint_eq(stats.inserts, 3);
+  ck_assert_uint_eq(stats.deletes, 1);
+  ck_assert_uint_eq(stats.gets, 1);
+  ck_assert_uint_eq(stats.ats, 1);
+  ck_assert_uint_eq(stats.order_changes, 1);
+  ck_assert_uint_eq(stats.write_wait.count, 5);
+  ck_assert_uint_eq(stats.write_hold.count, 5);
+  ck_assert_uint_eq(stats.read_hold.count, 2);
+  ck_assert_uint_eq(stats.traversal.max, 2);
+
+  llist_stats_reset(llist);
+  ck_assert_int_eq(llist_stats(llist, &stats), 0);
+  ck_assert_uint_eq(stats.inserts, 0);
+  ck_assert_uint_eq(stats.write_wait.count, 0);
+#else
+  ck_assert_int_eq(llist_stats(llist, &stats), -1);
+#endif
+}
+END_TEST
+
+START_TEST(test_mt_llist_adaptive_lock)
+/* Tests the thread-safety of a list using an adaptive
+** lock. Half of the threads insert while the other
+** half look up llnodes that are already present.
+**/
+{
+  int const NUM_LLNODES = 100;
+  pthread_t threads[NUM_LLNODES];
+  tsds_llarg_t llargs[NUM_LLNODES];
+  adlock_stats_t stats;
+
+  llist_free(llist);
+  llist = llist_create_with_flags(ASC, LLIST_ADAPTIVE_LOCK);
+
+  int i, r;
+  for (i = 0; i < NUM_LLNODES; i += 2)
+    llist_insert(llist, llnode_create(i));
+
+  for (i = 0; i < NUM_LLNODES; i++)
+  {
+    llargs[i].llist = llist;
+    llargs[i].data = i;
+    r = pthread_create(&threads[i], NULL,
+                       (i % 2 == 0) ? &tsds_llist_get : &tsds_llist_insert,
+                       (void *)&llargs[i]);
+    handle_error(r, "pthread_create");
+  }
+
+  for (i = 0; i < NUM_LLNODES; i++)
+  {
+    void * vptr;
+    r = pthread_join(threads[i], &vptr);
+    handle_error(r, "pthread_join");
+
+    if (i % 2 == 0)
+    {
+      ck_assert_ptr_nonnull((llnode_t *)vptr);
+      ck_assert_int_eq(((llnode_t *)vptr)->data, i);
+    }
+  }
+
+  ck_assert_uint_eq(llist->sz, NUM_LLNODES);
+  ck_assert_int_eq(tsds_llist_has_llorder(ASC), 1);
+
+  ck_assert_int_eq(llist_lock_stats(llist, &stats), 0);
+  ck_assert_uint_eq(stats.acquires, NUM_LLNODES + NUM_LLNODES/2);
+  ck_assert_uint_le(stats.contended, stats.acquires);
+}
+END_TEST
+
 Suite * 
 llist_suite(void)
 {
@@ -916,11 +1977,26 @@ llist_suite(void)
   tcase_add_test(tc_core, test_llist_get);
   tcase_add_test(tc_core, test_llist_sort);
   tcase_add_test(tc_core, test_llist_change_llorder);
+  tcase_add_test(tc_core, test_llist_adaptive_lock);
+  tcase_add_test(tc_core, test_llist_doubly_linked);
+  tcase_add_test(tc_core, test_llist_lazy_sort);
+  tcase_add_test(tc_core, test_llist_insert_finger);
+  tcase_add_test(tc_core, test_llist_range);
+  tcase_add_test(tc_core, test_llist_set_ops);
+  tcase_add_test(tc_core, test_llist_concat_split);
+  tcase_add_test(tc_core, test_llist_array_dump);
+  tcase_add_test(tc_core, test_llist_unique);
+  tcase_add_test(tc_core, test_llist_save_load);
+  tcase_add_test(tc_core, test_llmap);
+  tcase_add_test(tc_core, test_llpack);
+  tcase_add_test(tc_core, test_llroar);
+  tcase_add_test(tc_core, test_llist_stats);
 
   /* Multithreaded tests */
   tcase_add_test(tc_core, test_mt_llist_insert);
   tcase_add_test(tc_core, test_mt_llist_at);
   tcase_add_test(tc_core, test_mt_llist_get);
+  tcase_add_test(tc_core, test_mt_llist_adaptive_lock);
 
   suite_add_tcase(suite, tc_core);
 
@@ -0,0 +1,408 @@
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../headers/bintree.h"
+
+// Values below 2^LAT_SUB_BITS are exact, above that every power of
+// two is split into 2^LAT_SUB_BITS sub-buckets (~6% relative error)
+#define LAT_SUB_BITS 4
+#define LAT_SUB      (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS  ((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+typedef enum { DIST_UNIFORM, DIST_ZIPF } dist_t;
+typedef enum { LOAD_RANDOM, LOAD_SORTED } load_t;
+
+typedef struct {
+  uint64_t buckets[LAT_BUCKETS];
+  uint64_t count;
+} lat_hist_t;
+
+typedef struct {
+  int threads;
+  int key_range;
+  int read_pct;
+  int remove_pct;
+  double seconds;
+  double theta;
+  dist_t dist;
+  load_t load;
+  int bulk;
+  int flags;
+  int header;
+} bench_cfg_t;
+
+typedef struct {
+  double alpha;
+  double zetan;
+  double eta;
+  double theta;
+  int n;
+} zipf_t;
+
+typedef struct {
+  pthread_t thread;
+  uint64_t seed;
+  uint64_t ops;
+  lat_hist_t lat;
+} worker_t;
+
+static bintree_t *bt;
+static bench_cfg_t cfg;
+static zipf_t zipf;
+static volatile int stop;
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*
+static uint64_t next_rand(uint64_t *state)
+{
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static double next_unit(uint64_t *state)
+{
+  return (next_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Gray et al. zipfian generator, as used by YCSB
+static void zipf_init(zipf_t *z, int n, double theta)
+{
+  double zeta2 = 1.0 + pow(0.5, theta);
+  int i;
+
+  z->n = n;
+  z->theta = theta;
+  z->zetan = 0;
+  for(i = 1; i <= n; i++)
+    z->zetan += 1.0 / pow((double)i, theta);
+  z->alpha = 1.0 / (1.0 - theta);
+  z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+}
+
+static int zipf_next(zipf_t *z, uint64_t *state)
+{
+  double u = next_unit(state);
+  double uz = u * z->zetan;
+  int rank;
+
+  if(uz < 1.0)
+    rank = 0;
+  else if(uz < 1.0 + pow(0.5, z->theta))
+    rank = 1;
+  else
+    rank = (int)(z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+
+  if(rank >= z->n)
+    rank = z->n - 1;
+
+  // Scatter hot ranks so they are not all neighbours in the tree
+  return (int)(((uint64_t)rank * 2654435761ull) % (uint64_t)z->n);
+}
+
+static int next_key(uint64_t *state)
+{
+  if(cfg.dist == DIST_ZIPF)
+    return zipf_next(&zipf, state);
+  return (int)(next_rand(state) % (uint64_t)cfg.key_range);
+}
+
+static void lat_record(lat_hist_t *hist, uint64_t v)
+{
+  int idx;
+
+  if(v < LAT_SUB)
+    idx = (int)v;
+  else
+  {
+    int k = 63 - __builtin_clzll(v);
+    idx = (k - LAT_SUB_BITS + 1) * LAT_SUB +
+          (int)((v >> (k - LAT_SUB_BITS)) & (LAT_SUB - 1));
+  }
+  hist->buckets[idx]++;
+  hist->count++;
+}
+
+static uint64_t lat_percentile(const lat_hist_t *hist, double p)
+{
+  uint64_t rank = (uint64_t)ceil(p * (double)hist->count);
+  uint64_t seen = 0;
+  int idx, k;
+
+  if(hist->count == 0)
+    return 0;
+
+  for(idx = 0; idx < LAT_BUCKETS; idx++)
+  {
+    seen += hist->buckets[idx];
+    if(seen >= rank)
+      break;
+  }
+
+  if(idx < LAT_SUB)
+    return (uint64_t)idx;
+
+  k = idx / LAT_SUB + LAT_SUB_BITS - 1;
+  return ((uint64_t)LAT_SUB + (uint64_t)(idx % LAT_SUB)) << (k - LAT_SUB_BITS);
+}
+
+// Arena trees only own nodes made by bt_new_node
+static node_t* bench_node(int key)
+{
+  if(cfg.flags & BT_ARENA)
+    return bt_new_node(bt, key, "bench");
+  return new_node(key, "bench");
+}
+
+static void* worker(void *arg)
+{
+  worker_t *w = (worker_t *)arg;
+
+  while(!stop)
+  {
+    int key = next_key(&w->seed);
+    int is_read = (int)(next_rand(&w->seed) % 100) < cfg.read_pct;
+    uint64_t start = now_ns();
+
+    if(is_read)
+      find(bt, key);
+    else if((int)(next_rand(&w->seed) % 100) < cfg.remove_pct)
+      bt_remove(bt, key);
+    else
+      insert(bt, bench_node(key));
+
+    lat_record(&w->lat, now_ns() - start);
+    w->ops++;
+  }
+  return NULL;
+}
+
+static const char* engine_name()
+{
+  if(cfg.flags & BT_LOCKFREE)
+    return "bintree_lockfree";
+  if(cfg.flags & BT_BPLUS)
+    return "bintree_bplus";
+  if(cfg.flags & BT_FINE_LOCK)
+    return "bintree_fine";
+  if(cfg.flags & BT_BALANCED)
+    return "bintree_avl";
+  return "bintree";
+}
+
+static const char* structure_name()
+{
+  static char name[64];
+
+  snprintf(name, sizeof(name), "%s%s%s", engine_name(),
+           cfg.flags & BT_ARENA ? "_arena" : "",
+           cfg.bulk ? "_bulk" : "");
+  return name;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [-t threads] [-k key_range] [-r read_pct] [-x remove_pct]\n"
+          "          [-d uniform|zipf] [-z theta] [-s seconds]\n"
+          "          [-l random|sorted] [-u] [-b] [-p] [-f] [-c] [-a] [-H]\n"
+          "  -x  share of writes that remove instead of insert\n"
+          "  -l  order the prefill keys are inserted in\n"
+          "  -u  prefill with bt_bulk_load_threads instead of insert\n"
+          "  -b  use a balanced (AVL) tree\n"
+          "  -p  use the B+-tree engine\n"
+          "  -f  use the lock-free engine\n"
+          "  -c  use per-node locks coupled hand-over-hand\n"
+          "  -a  allocate nodes from the tree's arena\n"
+          "  -H  omit the CSV header\n", prog);
+}
+
+static int parse_args(int argc, char **argv)
+{
+  int opt;
+
+  cfg.threads = 4;
+  cfg.key_range = 1 << 16;
+  cfg.read_pct = 90;
+  cfg.remove_pct = 0;
+  cfg.seconds = 2.0;
+  cfg.theta = 0.99;
+  cfg.dist = DIST_UNIFORM;
+  cfg.load = LOAD_RANDOM;
+  cfg.bulk = 0;
+  cfg.flags = BT_DEFAULT;
+  cfg.header = 1;
+
+  while((opt = getopt(argc, argv, "t:k:r:x:d:z:s:l:ubpfcaH")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': cfg.threads = atoi(optarg); break;
+      case 'k': cfg.key_range = atoi(optarg); break;
+      case 'r': cfg.read_pct = atoi(optarg); break;
+      case 'x': cfg.remove_pct = atoi(optarg); break;
+      case 'z': cfg.theta = atof(optarg); break;
+      case 's': cfg.seconds = atof(optarg); break;
+      case 'u': cfg.bulk = 1; break;
+      case 'b': cfg.flags |= BT_BALANCED; break;
+      case 'p': cfg.flags |= BT_BPLUS; break;
+      case 'f': cfg.flags |= BT_LOCKFREE; break;
+      case 'c': cfg.flags |= BT_FINE_LOCK; break;
+      case 'a': cfg.flags |= BT_ARENA; break;
+      case 'H': cfg.header = 0; break;
+      case 'l':
+        if(!strcmp(optarg, "sorted"))
+          cfg.load = LOAD_SORTED;
+        else if(!strcmp(optarg, "random"))
+          cfg.load = LOAD_RANDOM;
+        else
+          return -1;
+        break;
+      case 'd':
+        if(!strcmp(optarg, "zipf"))
+          cfg.dist = DIST_ZIPF;
+        else if(!strcmp(optarg, "uniform"))
+          cfg.dist = DIST_UNIFORM;
+        else
+          return -1;
+        break;
+      default:
+        return -1;
+    }
+  }
+
+  if(cfg.threads < 1 || cfg.key_range < 2 ||
+     cfg.read_pct < 0 || cfg.read_pct > 100 ||
+     cfg.remove_pct < 0 || cfg.remove_pct > 100 ||
+     cfg.seconds <= 0 || cfg.theta <= 0 || cfg.theta >= 1)
+    return -1;
+  return 0;
+}
+
+// Inserts every other key of the range, shuffled unless -l sorted
+// is given. Sorted loads degenerate the unbalanced tree into a list.
+// With -u the keys are bulk loaded using every benchmark thread.
+static void prefill()
+{
+  int n = cfg.key_range / 2;
+  int *keys = (int *)malloc(sizeof(int) * n);
+  uint64_t seed = 42;
+  int i;
+
+  for(i = 0; i < n; i++)
+    keys[i] = 2 * i;
+
+  for(i = n - 1; i > 0 && cfg.load == LOAD_RANDOM; i--)
+  {
+    int j = (int)(next_rand(&seed) % (uint64_t)(i + 1));
+    int tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+
+  if(cfg.bulk)
+  {
+    char **values = (char **)malloc(sizeof(char *) * n);
+
+    for(i = 0; i < n; i++)
+      values[i] = "bench";
+    if(bt_bulk_load_threads(bt, keys, values, n, cfg.threads))
+    {
+      fprintf(stderr, "bulk load failed\n");
+      exit(1);
+    }
+    free(values);
+  }
+  else
+  {
+    for(i = 0; i < n; i++)
+      insert(bt, bench_node(keys[i]));
+  }
+
+  free(keys);
+}
+
+int main(int argc, char **argv)
+{
+  worker_t *workers;
+  lat_hist_t *total;
+  uint64_t ops = 0, start, elapsed, load, teardown;
+  int i, j;
+
+  if(parse_args(argc, argv))
+  {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(cfg.dist == DIST_ZIPF)
+    zipf_init(&zipf, cfg.key_range, cfg.theta);
+
+  bt_init(&bt, cfg.flags);
+  start = now_ns();
+  prefill();
+  load = now_ns() - start;
+
+  workers = (worker_t *)calloc(cfg.threads, sizeof(worker_t));
+  total = (lat_hist_t *)calloc(1, sizeof(lat_hist_t));
+  if(!workers || !total)
+    return EXIT_FAILURE;
+
+  start = now_ns();
+  for(i = 0; i < cfg.threads; i++)
+  {
+    workers[i].seed = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+    pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+  }
+
+  usleep((useconds_t)(cfg.seconds * 1e6));
+  stop = 1;
+
+  for(i = 0; i < cfg.threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    ops += workers[i].ops;
+    for(j = 0; j < LAT_BUCKETS; j++)
+      total->buckets[j] += workers[i].lat.buckets[j];
+    total->count += workers[i].lat.count;
+  }
+  elapsed = now_ns() - start;
+
+  start = now_ns();
+  free_bt(bt);
+  teardown = now_ns() - start;
+
+  if(cfg.header)
+    printf("structure,threads,key_range,read_pct,dist,load,load_ms,seconds,"
+           "ops,ops_per_sec,p50_ns,p99_ns,p999_ns,free_ms\n");
+
+  printf("%s,%d,%d,%d,%s,%s,%.1f,%.2f,%llu,%.0f,%llu,%llu,%llu,%.1f\n",
+         structure_name(),
+         cfg.threads, cfg.key_range, cfg.read_pct,
+         cfg.dist == DIST_ZIPF ? "zipf" : "uniform",
+         cfg.load == LOAD_SORTED ? "sorted" : "random",
+         load / 1e6,
+         elapsed / 1e9,
+         (unsigned long long)ops,
+         ops / (elapsed / 1e9),
+         (unsigned long long)lat_percentile(total, 0.50),
+         (unsigned long long)lat_percentile(total, 0.99),
+         (unsigned long long)lat_percentile(total, 0.999),
+         teardown / 1e6);
+
+  free(workers);
+  free(total);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// Bump allocator behind BT_ARENA trees. Memory comes from a list of
+// chunks and is only given back all at once, by arena_reset (which
+// keeps the chunks for reuse) or arena_free.
+#define BT_ARENA_CHUNK (1 << 20) // Bytes per chunk, larger requests get their own
+
+typedef struct _bt_chunk_t bt_chunk_t;
+typedef struct _bt_arena_t bt_arena_t;
+
+struct _bt_chunk_t {
+  bt_chunk_t *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+struct _bt_arena_t {
+  bt_chunk_t *chunks; // In allocation order
+  bt_chunk_t *cur;    // First chunk with room, NULL when empty
+  size_t chunk_count;
+};
+
+// All of these are NOT THREAD SAFE, bintree.c calls them
+// under the tree's recycle semaphore
+void arena_init(bt_arena_t *arena);
+void* arena_alloc(bt_arena_t *arena, size_t n);
+void arena_reset(bt_arena_t *arena);
+void arena_free(bt_arena_t *arena);
+
+#endif
@@ -3,36 +3,136 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <semaphore.h>
+#include "btstats.h"
+#include "arena.h"
+
+// Creation flags, combined with | and passed to bt_init
+typedef enum bt_flags {
+  BT_DEFAULT  = 0,
+  BT_BALANCED = 1 << 0, // AVL rebalancing on insert
+  BT_BPLUS    = 1 << 1, // B+-tree engine, see bplus.h
+  BT_LOCKFREE = 1 << 2, // Lock-free engine, see lockfree.h
+  BT_FINE_LOCK = 1 << 3, // Per-node locks taken hand-over-hand, never balanced
+  BT_ARENA    = 1 << 4  // bt_new_node allocates from the tree's arena
+} bt_flags;
+
+// AVL trees of 2^32 nodes are less than 48 levels deep
+#define BT_MAX_HEIGHT 64
+
+// bt_bulk_load_threads only hands subtrees of at least this many
+// nodes to another thread
+#define BT_BULK_SPLIT_MIN (1 << 16)
+
+// Values up to BT_INLINE_VALUE - 1 bytes fit in node_t itself, which
+// is then 56 bytes and one 64 byte malloc chunk. Longer copied values
+// extend the same allocation, only new_node_take leaves them apart.
+#define BT_INLINE_VALUE 11
 
 typedef struct _node_t node_t;
 typedef struct _bintree_t bintree_t;
+typedef struct _bp_node_t bp_node_t;
+typedef struct _lf_tree_t lf_tree_t;
+typedef struct _bt_iter_t bt_iter_t;
+
+// Called by bt_range on each node in order, nonzero stops the scan
+typedef int (*bt_range_fn)(node_t *n, void *ctx);
 
 struct _node_t {
   int key;
-  char *value;
+  int height; // Subtree height, maintained in BT_BALANCED trees
+  int lock;   // BT_FINE_LOCK trees: readers inside, or -1 for a writer
+  uint32_t value_len;
+  char *value; // NUL terminated, inline_value unless adopted
   node_t *left;
   node_t *right;
+  uint32_t value_cap; // Longest value the buffer can be reused for
+  char arena;         // Node lives in a tree's arena, see free_node
+  char inline_value[BT_INLINE_VALUE];
 };
 
 struct _bintree_t {
   node_t *head;
+  bp_node_t *bp_root; // Root of BT_BPLUS trees, head stays NULL
+  lf_tree_t *lf;      // BT_LOCKFREE trees, which bypass the semaphores
+  int head_lock;      // Guards head in BT_FINE_LOCK trees
+  int flags;
+  // Readers-writer lock with a turnstile so writers are not starved
+  sem_t mutex;      // guards readers_count
+  sem_t turnstile;  // writers hold it while waiting and writing
+  sem_t read_write; // held by a writer or by the group of readers
+  int readers_count;
+  // Removed and replaced nodes kept for bt_new_node, linked
+  // through right, arena nodes included
+  node_t *recycled;
+  sem_t recycle;    // guards recycled and arena
+  // BT_ARENA trees: every node must come from bt_new_node, and is
+  // only released as a whole by bt_reset or free_bt
+  bt_arena_t arena;
+#ifdef TSDS_STATS
+  bt_stats_t stats;
+#endif
+};
+
+// In-order iterator over [lo, hi], see bt_iter_seek. Besides bt,
+// lo and hi its fields belong to the engines.
+struct _bt_iter_t {
+  bintree_t *bt;
+  int lo;          // Next key wanted, bt_iter_resume seeks here
+  int hi;
+  int done;        // Every key up to hi was returned
+  int failed;      // The stack couldn't grow, the scan stopped early
+  int held;        // Read side or epoch held until bt_iter_release
+  uint64_t epoch;  // BT_LOCKFREE trees
+  node_t *cur;     // Last node returned, BT_FINE_LOCK keeps it read locked
+  bp_node_t *leaf; // BT_BPLUS trees: leaf and index of the next key
+  int pos;
+  void **stack;    // node_t or lf_node_t pointers left to visit
+  size_t top;
+  size_t cap;
 };
 
 // Creation ops
 void init(bintree_t **bt);
+void bt_init(bintree_t **bt, int flags);
 bintree_t* init_bt_with_head(int head_key, char* value);
 node_t* new_node(int key, char *value);
+node_t* new_node_len(int key, const char *value, size_t len);
+node_t* new_node_take(int key, char *value, size_t len);
+node_t* bt_new_node(bintree_t *bt, int key, char *value);
 
 // Insertion ops
-int insert_node(node_t **bt_n, node_t *n);
+int insert_node(node_t **bt_n, node_t *n, node_t **old);
 int insert(bintree_t *bt, node_t *n);
 
+// Bulk ops, for empty trees
+int bt_bulk_load(bintree_t *bt, int *keys, char **values, size_t n);
+int bt_bulk_load_threads(bintree_t *bt, int *keys, char **values, size_t n, int threads);
+
+// Removal ops
+int bt_remove(bintree_t *bt, int key);
+
 // Free mem ops
+void free_node(node_t *n);
 void free_subtree(node_t *n);
 void free_bt(bintree_t *bt);
+void bt_reset(bintree_t *bt);
 
 // Find ops
 node_t* find(bintree_t *bt, int key);
 node_t* find_in_subtree(node_t *n, int key);
 
+// Ordered ops
+int bt_range(bintree_t *bt, int lo, int hi, bt_range_fn fn, void *ctx);
+int bt_iter_seek(bt_iter_t *it, bintree_t *bt, int lo, int hi);
+node_t* bt_iter_next(bt_iter_t *it);
+int bt_iter_resume(bt_iter_t *it);
+void bt_iter_release(bt_iter_t *it);
+
+// Stats ops
+int bt_stats(bintree_t *bt, bt_stats_t *stats);
+void bt_stats_reset(bintree_t *bt);
+
 #endif
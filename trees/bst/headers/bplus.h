@@ -0,0 +1,36 @@
+#ifndef _BPLUS_H_
+#define _BPLUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bintree.h"
+
+// B+-tree engine behind BT_BPLUS trees. Inner nodes hold separator
+// keys, leaves hold the node_t of each key and are chained in key
+// order. Keys sit in their own array so a lower-bound search only
+// touches BT_BP_ORDER * 4 bytes (four cache lines) per level.
+#define BT_BP_ORDER      64  // Max keys per node
+#define BT_BP_MAX_HEIGHT 16  // Inner nodes keep >= BT_BP_ORDER / 2 keys
+
+struct _bp_node_t {
+  int leaf;
+  int n;            // Keys in use
+  bp_node_t *next;  // Next leaf in key order, leaves only
+  int keys[BT_BP_ORDER];
+  union {
+    bp_node_t *children[BT_BP_ORDER + 1]; // children[i] < keys[i] <= children[i + 1]
+    node_t *vals[BT_BP_ORDER];
+  } ptr;
+};
+
+// All of these are NOT THREAD SAFE, bintree.c calls them
+// under the tree's semaphores
+int bp_insert(bp_node_t **root, node_t *n, uint64_t *depth, node_t **old);
+node_t* bp_find(bp_node_t *root, int key, uint64_t *depth);
+node_t* bp_remove(bp_node_t *root, int key);
+bp_node_t* bp_first_leaf(bp_node_t *root);
+bp_node_t* bp_seek(bp_node_t *root, int key, int *pos);
+bp_node_t* bp_build(node_t **nodes, size_t n);
+void bp_free(bp_node_t *root, int free_nodes);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _BTSTATS_H_
+#define _BTSTATS_H_
+
+#include <stdint.h>
+
+// Bucket i counts samples in [2^(i-1), 2^i), bucket 0 counts
+// zero samples and the last bucket collects the overflow.
+#define BT_HIST_BUCKETS 32
+
+typedef struct _bt_hist_t bt_hist_t;
+typedef struct _bt_stats_t bt_stats_t;
+
+struct _bt_hist_t {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[BT_HIST_BUCKETS];
+};
+
+struct _bt_stats_t {
+  uint64_t inserts;
+  uint64_t finds;
+  uint64_t removes;
+  bt_hist_t turnstile_wait; // ns spent passing the turnstile
+  bt_hist_t write_wait;     // ns writers waited on read_write
+  bt_hist_t write_hold;     // ns writers held read_write
+  bt_hist_t read_wait;      // ns readers spent entering
+  bt_hist_t read_hold;      // ns readers spent searching
+  bt_hist_t depth;          // nodes visited per operation
+};
+
+// Instrumentation is compiled in only with TSDS_STATS (make STATS=1).
+// Otherwise the macros expand to nothing and arguments are not evaluated.
+#ifdef TSDS_STATS
+#define BTSTATS_ONLY(...)           __VA_ARGS__
+#define BTSTATS_INC(bt, field)      btstats_add(&(bt)->stats.field, 1)
+#define BTSTATS_RECORD(bt, hist, v) btstats_record(&(bt)->stats.hist, (v))
+#else
+#define BTSTATS_ONLY(...)
+#define BTSTATS_INC(bt, field)      ((void)0)
+#define BTSTATS_RECORD(bt, hist, v) ((void)0)
+#endif
+
+uint64_t btstats_now();
+void btstats_add(uint64_t *counter, uint64_t n);
+void btstats_record(bt_hist_t *hist, uint64_t v);
+void btstats_copy(bt_stats_t *dst, bt_stats_t *src);
+void btstats_reset(bt_stats_t *stats);
+uint64_t btstats_percentile(const bt_hist_t *hist, double p);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _LOCKFREE_H_
+#define _LOCKFREE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bintree.h"
+
+// Lock-free engine behind BT_LOCKFREE trees: the external BST of
+// Natarajan and Mittal (PPoPP 2014). Keys live in leaves, internal
+// nodes only route. A removal first flags the edge to its leaf, then
+// tags the sibling edge and swings the grandparent past both, so
+// updates only conflict when they touch the same few edges.
+//
+// Unlinked nodes are freed by epoch-based reclamation. Threads
+// announce themselves on one of BT_LF_STRIPES counters instead of
+// registering, and a node retired in epoch e is freed once no
+// thread is left in epoch e - 1 and the epoch moves past e + 1.
+#define BT_LF_STRIPES     64
+#define BT_LF_RETIRE_SCAN 64   // Retires between epoch advance attempts
+
+typedef struct _lf_node_t lf_node_t;
+// Takes back a node_t insert replaced, once no epoch can reach it
+typedef void (*lf_release_fn)(void *owner, node_t *n);
+typedef struct _lf_stripe_t lf_stripe_t;
+
+struct _lf_node_t {
+  int64_t key;       // Beyond INT_MAX for the three sentinels
+  node_t *node;      // Leaves only, NULL once removal is injected.
+                     // Retired ones carry a node_t insert replaced
+  uintptr_t left;    // Child address | flag bit | tag bit
+  uintptr_t right;
+  lf_node_t *retired_next;
+};
+
+struct _lf_stripe_t {
+  uint64_t active[2];  // Threads inside an even/odd epoch
+  char pad[64 - 2 * sizeof(uint64_t)];
+};
+
+struct _lf_tree_t {
+  lf_node_t *root;     // Sentinel R, its left child is sentinel S
+  uint64_t epoch;
+  uint64_t retires;
+  lf_node_t *retired[3]; // Indexed by retire epoch % 3
+  lf_release_fn release; // free_node if NULL
+  void *owner;
+  lf_stripe_t stripes[BT_LF_STRIPES];
+};
+
+lf_tree_t* lf_create(lf_release_fn release, void *owner);
+int lf_insert(lf_tree_t *lf, node_t *n);
+node_t* lf_find(lf_tree_t *lf, int key);
+node_t* lf_remove(lf_tree_t *lf, int key);
+int lf_build(lf_tree_t *lf, node_t **nodes, size_t n);
+void lf_free(lf_tree_t *lf, int free_nodes);
+
+// In-order scans for bt_iter_t, inside one epoch from seek to release.
+// bt_iter_push, from bintree.c, grows the iterator's stack.
+int bt_iter_push(bt_iter_t *it, void *n);
+uint64_t lf_iter_seek(lf_tree_t *lf, int lo, bt_iter_t *it);
+node_t* lf_iter_next(bt_iter_t *it, int *key);
+void lf_iter_release(lf_tree_t *lf, uint64_t e);
+
+#endif
@@ -4,6 +4,7 @@
 int main(int argc, char **argv)
 {
   bintree_t *bt;
+  int i;
   init(&bt);
 
   node_t * n0 = new_node(19, "root");
@@ -28,6 +29,109 @@ int main(int argc, char **argv)
   print_node(find(bt, 49));
 
  free_bt(bt);
+
+  // Sorted keys stay balanced in an AVL tree
+  bt_init(&bt, BT_BALANCED);
+  for(i = 1; i <= 7; i++)
+    insert(bt, new_node(i, "balanced"));
+
+  print(bt, PRE);
+  print_node(find(bt, 4));
+
+  bt_remove(bt, 4);
+  bt_remove(bt, 5);
+  insert(bt, bt_new_node(bt, 8, "recycled"));
+
+  print(bt, PRE);
+  print_node(find(bt, 4));
+  print_node(find(bt, 8));
+
+  free_bt(bt);
+
+  // Keys live in the leaves of a B+-tree
+  bt_init(&bt, BT_BPLUS);
+  for(i = 100; i > 0; i--)
+    insert(bt, new_node(i, "bplus"));
+  bt_remove(bt, 50);
+
+  print(bt, IN);
+  print_node(find(bt, 64));
+  print_node(find(bt, 50));
+
+  free_bt(bt);
+
+  // Finds on a lock-free tree take no locks at all
+  bt_init(&bt, BT_LOCKFREE);
+  for(i = 1; i <= 7; i++)
+    insert(bt, new_node(i * 10, "lockfree"));
+  bt_remove(bt, 40);
+
+  print(bt, IN);
+  print_node(find(bt, 30));
+  print_node(find(bt, 40));
+
+  free_bt(bt);
+
+  // Writers lock only the nodes on their path
+  bt_init(&bt, BT_FINE_LOCK);
+  insert(bt, new_node(19, "fine"));
+  insert(bt, new_node(21, "fine"));
+  insert(bt, new_node(18, "fine"));
+  bt_remove(bt, 19);
+
+  print(bt, PRE);
+  print_node(find(bt, 21));
+
+  free_bt(bt);
+
+  // Arena trees drop all their nodes at once
+  bt_init(&bt, BT_BALANCED | BT_ARENA);
+  for(i = 1; i <= 7; i++)
+    insert(bt, bt_new_node(bt, i, "arena"));
+  bt_reset(bt);
+  insert(bt, bt_new_node(bt, 42, "arena again"));
+
+  print(bt, IN);
+  print_node(find(bt, 42));
+
+  free_bt(bt);
+
+  // Sorted keys are built into a balanced tree in one pass
+  {
+    int keys[] = { 1, 2, 3, 4, 5, 6, 7 };
+    char *values[] = { "a", "b", "c", "d", "e", "f", "g" };
+
+    bt_init(&bt, BT_BALANCED);
+    bt_bulk_load(bt, keys, values, 7);
+
+    print(bt, PRE);
+    print_node(find(bt, 6));
+
+    free_bt(bt);
+  }
+
+  // Paginated scan, the tree is released between pages
+  {
+    bt_iter_t it;
+    node_t *n;
+    int page = 0, count;
+
+    bt_init(&bt, BT_BALANCED);
+    for(i = 1; i <= 10; i++)
+      insert(bt, new_node(i * 10, "page"));
+
+    bt_iter_seek(&it, bt, 25, 95);
+    do
+    {
+      printf("page %d   : ", page++);
+      for(count = 0; count < 3 && (n = bt_iter_next(&it)); count++)
+        printf(" %d ", n->key);
+      printf("\n");
+      bt_iter_release(&it);
+    } while(count == 3 && bt_iter_resume(&it) == 0);
+
+    free_bt(bt);
+  }
   
   return 0;
 }
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include "../headers/arena.h"
+
+// Keeps every allocation aligned for node_t's pointers
+#define ARENA_ALIGN sizeof(void *)
+
+void arena_init(bt_arena_t *arena)
+{
+  arena->chunks = NULL;
+  arena->cur = NULL;
+  arena->chunk_count = 0;
+}
+
+static bt_chunk_t* new_chunk(size_t n)
+{
+  size_t size = n > BT_ARENA_CHUNK ? n : BT_ARENA_CHUNK;
+  bt_chunk_t *chunk = (bt_chunk_t *)malloc(sizeof(bt_chunk_t) + size);
+
+  if(chunk)
+  {
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+  }
+  return chunk;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Bumps the current chunk. Chunks kept by arena_reset are
+ * refilled in order before new ones are allocated.
+ */
+void* arena_alloc(bt_arena_t *arena, size_t n)
+{
+  bt_chunk_t *chunk = arena->cur, *last = NULL;
+  void *p;
+
+  n = (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  while(chunk && chunk->used + n > chunk->size)
+  {
+    last = chunk;
+    chunk = chunk->next;
+  }
+
+  if(!chunk)
+  {
+    if(!(chunk = new_chunk(n)))
+      return NULL;
+
+    // Only an empty arena has no current chunk
+    if(last)
+      last->next = chunk;
+    else
+      arena->chunks = chunk;
+    arena->chunk_count++;
+  }
+
+  arena->cur = chunk;
+  p = chunk->data + chunk->used;
+  chunk->used += n;
+
+  return p;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Forgets every allocation in O(chunks), keeping the chunks
+ */
+void arena_reset(bt_arena_t *arena)
+{
+  bt_chunk_t *chunk;
+
+  for(chunk = arena->chunks; chunk; chunk = chunk->next)
+    chunk->used = 0;
+  arena->cur = arena->chunks;
+}
+
+/*
+ * NOT THREAD SAFE
+ */
+void arena_free(bt_arena_t *arena)
+{
+  while(arena->chunks)
+  {
+    bt_chunk_t *next = arena->chunks->next;
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+  arena_init(arena);
+}
@@ -1,14 +1,51 @@
-#include <semaphore.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include "../headers/bintree.h"
+#include "../headers/bplus.h"
+#include "../headers/lockfree.h"
 
-sem_t mutex, turnstile, read_write;
+static void init_sems(bintree_t *bt)
+{
+  sem_init(&bt->mutex, 0, 1);
+  sem_init(&bt->turnstile, 0, 1);
+  sem_init(&bt->read_write, 0, 1);
+  sem_init(&bt->recycle, 0, 1);
+  bt->readers_count = 0;
+  bt->recycled = NULL;
+  arena_init(&bt->arena);
+}
+
+static void destroy_sems(bintree_t *bt)
+{
+  sem_destroy(&bt->mutex);
+  sem_destroy(&bt->turnstile);
+  sem_destroy(&bt->read_write);
+  sem_destroy(&bt->recycle);
+}
+
+// Bytes for a node whose value is copied in behind inline_value
+static size_t node_size(size_t len)
+{
+  size_t size = offsetof(node_t, inline_value) + len + 1;
+  return size > sizeof(node_t) ? size : sizeof(node_t);
+}
 
-void init_sems()
+// Points value at the bytes behind inline_value, node_size(len) long
+static void use_inline_value(node_t *node, size_t len)
 {
-  sem_init(&mutex, 0, 1);
-  sem_init(&turnstile, 0, 1);
-  sem_init(&read_write, 0, 1);
+  node->value = node->inline_value;
+  node->value_cap = (uint32_t)(node_size(len) - offsetof(node_t, inline_value) - 1);
+}
+
+static void init_node(node_t *node, int key, size_t len)
+{
+  node->key = key;
+  node->value_len = (uint32_t)len;
+  node->height = 1;
+  node->lock = 0;
+  node->left = NULL;
+  node->right = NULL;
 }
 
 /*
@@ -18,164 +55,1427 @@ void init_sems()
  */
 node_t* new_node(int key, char *value)
 {
-  node_t *node  = (node_t *)malloc(sizeof(node_t));
-  
-  node->key = key;
-  node->value = (char *)malloc(strlen(value) + 1);
-  strcpy(node->value, value);
+  return new_node_len(key, value, strlen(value));
+}
+
+/*
+ * Copies len bytes of value into the node's own allocation,
+ * value needs no NUL terminator
+ */
+node_t* new_node_len(int key, const char *value, size_t len)
+{
+  node_t *node = (node_t *)malloc(node_size(len));
+
+  if(!node)
+    return NULL;
+
+  init_node(node, key, len);
+  use_inline_value(node, len);
+  node->arena = 0;
+  memcpy(node->value, value, len);
+  node->value[len] = '\0';
+
+  return node;
+}
+
+/*
+ * Adopts value without copying it. It must come from malloc and
+ * hold len bytes followed by a NUL, the node frees it.
+ */
+node_t* new_node_take(int key, char *value, size_t len)
+{
+  node_t *node = (node_t *)malloc(sizeof(node_t));
+
+  if(!node)
+    return NULL;
+
+  init_node(node, key, len);
+  node->value = value;
+  node->value_cap = (uint32_t)len;
+  node->arena = 0;
+
+  return node;
+}
+
+/*
+ * Like new_node, but reuses a node removed from bt when its
+ * value buffer is large enough, and takes new nodes from the
+ * arena of BT_ARENA trees. Safe to call concurrently with any
+ * other operation on bt.
+ */
+node_t* bt_new_node(bintree_t *bt, int key, char *value)
+{
+  node_t *node = NULL;
+  size_t len = strlen(value);
+
+  if(!bt)
+    return new_node_len(key, value, len);
+
+  sem_wait(&bt->recycle);
+  if(bt->recycled && bt->recycled->value_cap >= len)
+  {
+    node = bt->recycled;
+    bt->recycled = node->right;
+  }
+  else if(bt->flags & BT_ARENA)
+  {
+    node = (node_t *)arena_alloc(&bt->arena, node_size(len));
+    if(node)
+    {
+      use_inline_value(node, len);
+      node->arena = 1;
+    }
+  }
+  sem_post(&bt->recycle);
+
+  if(!node)
+    return new_node_len(key, value, len);
+
+  init_node(node, key, len);
+  memcpy(node->value, value, len + 1);
 
-  node->left = NULL;
-  node->right = NULL;
-  
   return node;
 }
 
+// Keeps a node unlinked from bt for bt_new_node, see bt_remove
+static void recycle_node(bintree_t *bt, node_t *n)
+{
+  if(!n)
+    return;
+
+  n->lock = 0;
+  n->left = NULL;
+  sem_wait(&bt->recycle);
+  n->right = bt->recycled;
+  bt->recycled = n;
+  sem_post(&bt->recycle);
+}
+
+// Lock-free trees hand back replaced nodes once their epochs end
+static void recycle_lf_node(void *bt, node_t *n)
+{
+  recycle_node((bintree_t *)bt, n);
+}
+
 bintree_t* init_bt_with_head(int head_key, char* value)
 {
   bintree_t *bt = (bintree_t *)malloc(sizeof(bintree_t));
   bt->head = new_node(head_key, value);
+  bt->bp_root = NULL;
+  bt->lf = NULL;
+  bt->head_lock = 0;
+  bt->flags = BT_DEFAULT;
+  init_sems(bt);
+  BTSTATS_ONLY(btstats_reset(&bt->stats);)
   return bt;
 }
 
 void init(bintree_t **bt)
 {
-  init_sems();
+  bt_init(bt, BT_DEFAULT);
+}
+
+void bt_init(bintree_t **bt, int flags)
+{
   *bt = (bintree_t *)malloc(sizeof(bintree_t));
+  (*bt)->head = NULL;
+  (*bt)->bp_root = NULL;
+  (*bt)->lf = flags & BT_LOCKFREE ? lf_create(recycle_lf_node, *bt) : NULL;
+  (*bt)->head_lock = 0;
+  // Rotations would have to lock whole paths
+  (*bt)->flags = flags & BT_FINE_LOCK ? flags & ~BT_BALANCED : flags;
+  init_sems(*bt);
+  BTSTATS_ONLY(btstats_reset(&(*bt)->stats);)
 }
 
 /*
  * NOT THREAD SAFE
- * Helper function only used by find
+ * Frees n and an adopted value unless n belongs to an arena
  */
-void free_subtree(node_t *n)
+void free_node(node_t *n)
 {
-  if(n)
+  if(n && !n->arena)
   {
-    free_subtree(n->left);
-    free_subtree(n->right);
-    free(n->value);
+    if(n->value != n->inline_value)
+      free(n->value);
     free(n);
   }
 }
 
-void free_bt(bintree_t *bt)
+/*
+ * NOT THREAD SAFE
+ * Rotates left children up until the current node has none,
+ * so degenerate trees are freed without deep recursion
+ */
+void free_subtree(node_t *n)
 {
-  sem_wait(&read_write);
-  sem_wait(&mutex);
+  while(n)
+  {
+    node_t *next;
 
-  if(bt)
+    if(n->left)
+    {
+      next = n->left;
+      n->left = next->right;
+      next->right = n;
+    }
+    else
+    {
+      next = n->right;
+      free_node(n);
+    }
+    n = next;
+  }
+}
+
+/*
+ * NOT THREAD SAFE
+ * Drops every key and recycled node. Arena trees release their
+ * nodes by rewinding the arena instead of visiting them.
+ */
+static void clear_bt(bintree_t *bt)
+{
+  int free_nodes = !(bt->flags & BT_ARENA);
+
+  if(free_nodes)
   {
     free_subtree(bt->head);
-    free(bt);
+    while(bt->recycled)
+    {
+      node_t *n = bt->recycled;
+      bt->recycled = n->right;
+      free_node(n);
+    }
   }
-  
-  sem_post(&mutex);
-  sem_post(&read_write);
+  bt->head = NULL;
+  bt->recycled = NULL;
+
+  bp_free(bt->bp_root, free_nodes);
+  bt->bp_root = NULL;
+  lf_free(bt->lf, free_nodes);
+  bt->lf = NULL;
+}
+
+/*
+ * The tree's semaphores go away with it, so no other thread
+ * may use bt once free_bt has been called
+ */
+void free_bt(bintree_t *bt)
+{
+  if(!bt)
+    return;
+
+  sem_wait(&bt->read_write);
+  sem_wait(&bt->mutex);
+
+  clear_bt(bt);
+  arena_free(&bt->arena);
+
+  sem_post(&bt->mutex);
+  sem_post(&bt->read_write);
+
+  destroy_sems(bt);
+  free(bt);
+}
+
+/*
+ * Empties bt for reuse, keeping the chunks of its arena. Like
+ * free_bt it must not run concurrently with other operations,
+ * and node pointers from bt are invalid afterwards.
+ */
+void bt_reset(bintree_t *bt)
+{
+  if(!bt)
+    return;
+
+  sem_wait(&bt->read_write);
+  sem_wait(&bt->mutex);
+
+  clear_bt(bt);
+  if(bt->flags & BT_LOCKFREE)
+    bt->lf = lf_create(recycle_lf_node, bt);
+  arena_reset(&bt->arena);
+
+  sem_post(&bt->mutex);
+  sem_post(&bt->read_write);
+}
+
+/*
+ * NOT THREAD SAFE
+ * Puts n in *slot. A node already there with the same key hands
+ * its children over to n and is returned, it's not freed since
+ * callers of find may still hold it.
+ */
+static node_t* replace_node(node_t **slot, node_t *n)
+{
+  node_t *old = *slot;
+
+  *slot = n;
+  if(!old || old == n)
+    return NULL;
+
+  n->left = old->left;
+  n->right = old->right;
+  n->height = old->height;
+  old->left = NULL;
+  old->right = NULL;
+  return old;
 }
 
 /*
  * NOT THREAD SAFE
- * Helper function only used by insert
+ * Slot holding key below *slot, or the empty one it belongs in.
+ * Counts the nodes visited past the first into depth.
  */
-int insert_node(node_t **bt_n, node_t *n)
+static node_t** find_slot(node_t **slot, int key, uint64_t *depth)
 {
-  if(!*bt_n || (*bt_n)->key == n->key)
+  while(*slot && (*slot)->key != key)
   {
-    *bt_n = n;
-    return 0;
+    slot = (*slot)->key < key ? &(*slot)->right : &(*slot)->left;
+    (*depth)++;
   }
-  
-  if((*bt_n)->key < n->key) return insert_node( &(*bt_n)->right, n);
-  return insert_node( &(*bt_n)->left, n);
+  return slot;
 }
 
-// Note: May have to pass *bt by reference
-int insert(bintree_t *bt, node_t *n)
+/*
+ * NOT THREAD SAFE
+ * Inserts n below *bt_n without rebalancing. A replaced node with
+ * the same key is stored in *old, else NULL, for the caller to
+ * free or recycle like insert does.
+ */
+int insert_node(node_t **bt_n, node_t *n, node_t **old)
 {
-  int ret = 0;
+  uint64_t depth = 0;
+
+  *old = replace_node(find_slot(bt_n, n->key, &depth), n);
+  return 0;
+}
+
+static int height(node_t *n)
+{
+  return n ? n->height : 0;
+}
+
+static void update_height(node_t *n)
+{
+  int l = height(n->left), r = height(n->right);
+  n->height = (l > r ? l : r) + 1;
+}
 
-  sem_wait(&turnstile);
-  sem_wait(&read_write);
+static node_t* rotate_left(node_t *n)
+{
+  node_t *r = n->right;
+
+  n->right = r->left;
+  r->left = n;
+  update_height(n);
+  update_height(r);
+  return r;
+}
+
+static node_t* rotate_right(node_t *n)
+{
+  node_t *l = n->left;
+
+  n->left = l->right;
+  l->right = n;
+  update_height(n);
+  update_height(l);
+  return l;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Restores the AVL invariant at n, whose subtrees differ in
+ * height by at most 2, and returns the new subtree root
+ */
+static node_t* rebalance(node_t *n)
+{
+  int balance = height(n->left) - height(n->right);
 
-  if(bt && bt->head && n)
+  if(balance > 1)
   {
-    if(bt->head->key == n->key)
-    {
-      bt->head = n;
-      ret = 0;
-    }
-    else if(bt->head->key < n->key)
-    {
-      ret = insert_node(&bt->head->right, n);
-    }
-    else
-    {
-      ret = insert_node(&bt->head->left, n);
-    }
+    if(height(n->left->left) < height(n->left->right))
+      n->left = rotate_left(n->left);
+    return rotate_right(n);
   }
-  else
+  if(balance < -1)
   {
-    if(bt && n && !bt->head)
-      bt->head = n;
-    else
-      ret = -1;
+    if(height(n->right->right) < height(n->right->left))
+      n->right = rotate_right(n->right);
+    return rotate_left(n);
   }
 
-  sem_post(&read_write);
-  sem_post(&turnstile);
-
-  return ret;
+  update_height(n);
+  return n;
 }
 
 /*
  * NOT THREAD SAFE
- * Helper function only used by find
+ * Iterative AVL insert, returns the number of nodes visited and
+ * sets *old to a replaced node with the same key. The slots on
+ * the path stay valid while rebalancing since a rotation only
+ * rewrites slots below the one it starts from.
  */
-node_t* find_in_subtree(node_t *n, int key)
+static uint64_t insert_balanced(node_t **root, node_t *n, node_t **old)
 {
-  node_t *node = NULL;
+  node_t **path[BT_MAX_HEIGHT];
+  node_t **slot = root;
+  uint64_t visited;
+  int top = 0;
 
-  if(n)
+  while(*slot && (*slot)->key != n->key)
   {
-    if(n->key == key)
-      node = n;
-    else if(n->key < key)
-      node = find_in_subtree(n->right, key);
-    else
-      node = find_in_subtree(n->left, key);
+    path[top++] = slot;
+    slot = (*slot)->key < n->key ? &(*slot)->right : &(*slot)->left;
   }
+  visited = (uint64_t)top + 1;
 
-  return node;
+  if(*slot)
+  {
+    *old = replace_node(slot, n);
+    return visited;
+  }
+
+  n->left = NULL;
+  n->right = NULL;
+  n->height = 1;
+  *slot = n;
+
+  while(top-- > 0)
+  {
+    int h = (*path[top])->height;
+
+    *path[top] = rebalance(*path[top]);
+    if((*path[top])->height == h)
+      break;
+  }
+
+  return visited;
 }
 
-node_t* find(bintree_t *bt, int key)
+/*
+ * Reader-writer spinlocks for BT_FINE_LOCK trees, the word
+ * counts readers inside or is -1 while a writer holds it.
+ * Waiters yield after a while, threads may outnumber cores.
+ */
+#define SPINS_BEFORE_YIELD 64
+
+static void rw_wait(int *spins)
+{
+  if(++*spins == SPINS_BEFORE_YIELD)
+  {
+    *spins = 0;
+    sched_yield();
+  }
+}
+
+static void rw_read_lock(int *lock)
 {
-  static int readers_count = 0;
+  int spins = 0, v;
 
-  node_t *n = NULL;
+  for(;;)
+  {
+    v = __atomic_load_n(lock, __ATOMIC_RELAXED);
+    if(v >= 0 && __atomic_compare_exchange_n(lock, &v, v + 1, 1,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return;
+    rw_wait(&spins);
+  }
+}
+
+static void rw_read_unlock(int *lock)
+{
+  __atomic_fetch_sub(lock, 1, __ATOMIC_RELEASE);
+}
+
+static void rw_write_lock(int *lock)
+{
+  int spins = 0, v;
+
+  for(;;)
+  {
+    v = 0;
+    if(__atomic_compare_exchange_n(lock, &v, -1, 1,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return;
+    rw_wait(&spins);
+  }
+}
 
-  sem_wait(&turnstile);
-  sem_post(&turnstile);
+static void rw_write_unlock(int *lock)
+{
+  __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * BT_FINE_LOCK insert. Write locks are coupled down the path, the
+ * lock of a node is only released once its child's is held, so a
+ * writer holds at most two locks and writers in disjoint subtrees
+ * only meet near the root. Every thread locks top-down, so there
+ * is no deadlock.
+ */
+static int insert_fine(bintree_t *bt, node_t *n, uint64_t *depth)
+{
+  int *held = &bt->head_lock;
+  node_t **slot = &bt->head, *cur;
 
-  sem_wait(&mutex);
+  n->lock = 0;
+  n->left = NULL;
+  n->right = NULL;
 
-  readers_count++;
-  if(readers_count == 1)
-    sem_wait(&read_write);
+  rw_write_lock(held);
+  while((cur = *slot) && cur->key != n->key)
+  {
+    rw_write_lock(&cur->lock);
+    rw_write_unlock(held);
+    held = &cur->lock;
+    slot = cur->key < n->key ? &cur->right : &cur->left;
+    (*depth)++;
+  }
 
-  sem_post(&mutex);
+  if(cur && cur != n)
+  {
+    // Readers only reach cur through the slot's owner, whose
+    // lock is held, so once cur's lock is ours nobody is inside.
+    // Callers of find may still hold it, so it's recycled.
+    rw_write_lock(&cur->lock);
+    n->left = cur->left;
+    n->right = cur->right;
+    *slot = n;
+    rw_write_unlock(held);
+    recycle_node(bt, cur);
+    return 0;
+  }
 
-  if(bt && bt->head)
-    n = find_in_subtree(bt->head, key);
+  *slot = n;
+  rw_write_unlock(held);
+  return 0;
+}
 
-  sem_wait(&mutex);
+// BT_FINE_LOCK find, read locks coupled down the path
+static node_t* find_fine(bintree_t *bt, int key, uint64_t *depth)
+{
+  int *held = &bt->head_lock;
+  node_t *n;
 
-  readers_count--;
-  if(readers_count == 0)
-    sem_post(&read_write);
+  rw_read_lock(held);
+  n = bt->head;
+  while(n)
+  {
+    rw_read_lock(&n->lock);
+    rw_read_unlock(held);
+    held = &n->lock;
+    (*depth)++;
 
-  sem_post(&mutex);
+    if(n->key == key)
+      break;
+    n = n->key < key ? n->right : n->left;
+  }
+  rw_read_unlock(held);
 
   return n;
 }
 
+/*
+ * BT_FINE_LOCK removal. The slot's owner and the victim stay
+ * write locked while the successor is found by coupling down the
+ * right subtree, so every node whose links change is locked.
+ */
+static node_t* remove_fine(bintree_t *bt, int key)
+{
+  int *held = &bt->head_lock;
+  node_t **slot = &bt->head, **succ_slot, *victim, *succ, *prev = NULL;
+
+  rw_write_lock(held);
+  while((victim = *slot) && victim->key != key)
+  {
+    rw_write_lock(&victim->lock);
+    rw_write_unlock(held);
+    held = &victim->lock;
+    slot = victim->key < key ? &victim->right : &victim->left;
+  }
+
+  if(!victim)
+  {
+    rw_write_unlock(held);
+    return NULL;
+  }
+
+  rw_write_lock(&victim->lock);
+  if(!victim->left || !victim->right)
+  {
+    *slot = victim->left ? victim->left : victim->right;
+  }
+  else
+  {
+    succ_slot = &victim->right;
+    succ = victim->right;
+    rw_write_lock(&succ->lock);
+    while(succ->left)
+    {
+      rw_write_lock(&succ->left->lock);
+      if(prev)
+        rw_write_unlock(&prev->lock);
+      prev = succ;
+      succ_slot = &succ->left;
+      succ = succ->left;
+    }
+
+    *succ_slot = succ->right;
+    succ->left = victim->left;
+    succ->right = victim->right;
+    *slot = succ;
+
+    if(prev)
+      rw_write_unlock(&prev->lock);
+    rw_write_unlock(&succ->lock);
+  }
+  rw_write_unlock(held);
+
+  victim->lock = 0;
+  victim->left = NULL;
+  victim->right = NULL;
+  return victim;
+}
+
+// Note: May have to pass *bt by reference
+int insert(bintree_t *bt, node_t *n)
+{
+  node_t *old = NULL;
+  int ret = 0;
+  BTSTATS_ONLY(uint64_t start = btstats_now(), entered, held, depth = 1;)
+
+  if(!bt)
+    return -1;
+
+  if(bt->flags & BT_LOCKFREE)
+  {
+    BTSTATS_INC(bt, inserts);
+    return n ? lf_insert(bt->lf, n) : -1;
+  }
+
+  if(bt->flags & BT_FINE_LOCK)
+  {
+    uint64_t levels = 1;
+
+    if(!n)
+      return -1;
+    ret = insert_fine(bt, n, &levels);
+    BTSTATS_INC(bt, inserts);
+    BTSTATS_RECORD(bt, depth, levels);
+    return ret;
+  }
+
+  sem_wait(&bt->turnstile);
+  BTSTATS_ONLY(entered = btstats_now();)
+  sem_wait(&bt->read_write);
+  BTSTATS_ONLY(held = btstats_now();)
+
+  if(n && (bt->flags & BT_BPLUS))
+  {
+    uint64_t levels;
+    ret = bp_insert(&bt->bp_root, n, &levels, &old);
+    BTSTATS_ONLY(depth = levels;)
+  }
+  else if(n && (bt->flags & BT_BALANCED))
+  {
+#ifdef TSDS_STATS
+    depth = insert_balanced(&bt->head, n, &old);
+#else
+    insert_balanced(&bt->head, n, &old);
+#endif
+  }
+  else if(bt->head && n)
+  {
+    uint64_t levels = 1;
+
+    old = replace_node(find_slot(&bt->head, n->key, &levels), n);
+    BTSTATS_ONLY(depth = levels;)
+  }
+  else
+  {
+    if(n && !bt->head)
+      bt->head = n;
+    else
+      ret = -1;
+  }
+
+  BTSTATS_INC(bt, inserts);
+  BTSTATS_RECORD(bt, depth, depth);
+  BTSTATS_RECORD(bt, turnstile_wait, entered - start);
+  BTSTATS_RECORD(bt, write_wait, held - entered);
+  BTSTATS_RECORD(bt, write_hold, btstats_now() - held);
+
+  sem_post(&bt->read_write);
+  sem_post(&bt->turnstile);
+
+  recycle_node(bt, old);
+  return ret;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Unlinks the node with key from the tree rooted at *root and
+ * returns it, or NULL if there is none. A node with two children
+ * is replaced by its in-order successor node rather than having
+ * the successor's key and value copied into it, so nodes that
+ * stay in the tree never change under a caller holding them.
+ * In balanced trees the path is rebalanced bottom-up.
+ */
+static node_t* remove_node(node_t **root, int key, int balanced)
+{
+  node_t **path[BT_MAX_HEIGHT];
+  node_t **slot = root, **succ_slot;
+  node_t *victim, *succ;
+  int top = 0, victim_top;
+
+  while(*slot && (*slot)->key != key)
+  {
+    if(balanced)
+      path[top++] = slot;
+    slot = (*slot)->key < key ? &(*slot)->right : &(*slot)->left;
+  }
+
+  victim = *slot;
+  if(!victim)
+    return NULL;
+
+  if(!victim->left || !victim->right)
+  {
+    *slot = victim->left ? victim->left : victim->right;
+  }
+  else
+  {
+    // The successor takes the victim's place, and with it the
+    // victim's slot on the path
+    victim_top = top;
+    if(balanced)
+      path[top++] = slot;
+
+    succ_slot = &victim->right;
+    while((*succ_slot)->left)
+    {
+      if(balanced)
+        path[top++] = succ_slot;
+      succ_slot = &(*succ_slot)->left;
+    }
+
+    succ = *succ_slot;
+    *succ_slot = succ->right;
+    succ->left = victim->left;
+    succ->right = victim->right;
+    succ->height = victim->height;
+    *slot = succ;
+
+    if(balanced && top > victim_top + 1 && path[victim_top + 1] == &victim->right)
+      path[victim_top + 1] = &succ->right;
+  }
+
+  while(top-- > 0)
+  {
+    int h = (*path[top])->height;
+
+    *path[top] = rebalance(*path[top]);
+    if((*path[top])->height == h)
+      break;
+  }
+
+  victim->left = NULL;
+  victim->right = NULL;
+  return victim;
+}
+
+/*
+ * Removes key from bt, returns 0 on success and -1 if the key
+ * is absent. find only walks the tree while holding read_write,
+ * so no reader can reach the node once it is unlinked. The node
+ * and its value are kept for bt_new_node and freed by free_bt,
+ * so pointers returned by an earlier find never dangle, though
+ * they may be reused for another key. Lock-free finds never
+ * dereference the node_t, only the leaf pointing at it.
+ */
+int bt_remove(bintree_t *bt, int key)
+{
+  node_t *victim;
+  BTSTATS_ONLY(uint64_t start = btstats_now(), entered, held;)
+
+  if(!bt)
+    return -1;
+
+  if(bt->flags & BT_LOCKFREE)
+  {
+    BTSTATS_INC(bt, removes);
+    victim = lf_remove(bt->lf, key);
+  }
+  else if(bt->flags & BT_FINE_LOCK)
+  {
+    BTSTATS_INC(bt, removes);
+    victim = remove_fine(bt, key);
+  }
+  else
+  {
+    sem_wait(&bt->turnstile);
+    BTSTATS_ONLY(entered = btstats_now();)
+    sem_wait(&bt->read_write);
+    BTSTATS_ONLY(held = btstats_now();)
+
+    if(bt->flags & BT_BPLUS)
+      victim = bp_remove(bt->bp_root, key);
+    else
+      victim = remove_node(&bt->head, key, bt->flags & BT_BALANCED);
+
+    BTSTATS_INC(bt, removes);
+    BTSTATS_RECORD(bt, turnstile_wait, entered - start);
+    BTSTATS_RECORD(bt, write_wait, held - entered);
+    BTSTATS_RECORD(bt, write_hold, btstats_now() - held);
+
+    sem_post(&bt->read_write);
+    sem_post(&bt->turnstile);
+  }
+
+  if(!victim)
+    return -1;
+
+  recycle_node(bt, victim);
+  return 0;
+}
+
+/*
+ * NOT THREAD SAFE
+ * find_in_subtree that also counts the nodes visited into depth
+ */
+static node_t* find_in_subtree_counted(node_t *n, int key, uint64_t *depth)
+{
+  while(n && n->key != key)
+  {
+    n = n->key < key ? n->right : n->left;
+    (*depth)++;
+  }
+
+  if(n)
+    (*depth)++;
+
+  return n;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Helper function only used by find
+ */
+node_t* find_in_subtree(node_t *n, int key)
+{
+  uint64_t depth = 0;
+  return find_in_subtree_counted(n, key, &depth);
+}
+
+node_t* find(bintree_t *bt, int key)
+{
+  node_t *n = NULL;
+  uint64_t depth = 0;
+  BTSTATS_ONLY(uint64_t start = btstats_now(), entered, held;)
+
+  if(!bt)
+    return NULL;
+
+  if(bt->flags & BT_LOCKFREE)
+  {
+    BTSTATS_INC(bt, finds);
+    return lf_find(bt->lf, key);
+  }
+
+  if(bt->flags & BT_FINE_LOCK)
+  {
+    uint64_t levels = 0;
+
+    n = find_fine(bt, key, &levels);
+    BTSTATS_INC(bt, finds);
+    BTSTATS_RECORD(bt, depth, levels);
+    return n;
+  }
+
+  sem_wait(&bt->turnstile);
+  sem_post(&bt->turnstile);
+  BTSTATS_ONLY(entered = btstats_now();)
+
+  sem_wait(&bt->mutex);
+
+  bt->readers_count++;
+  if(bt->readers_count == 1)
+    sem_wait(&bt->read_write);
+
+  sem_post(&bt->mutex);
+  BTSTATS_ONLY(held = btstats_now();)
+
+  if(bt->flags & BT_BPLUS)
+    n = bp_find(bt->bp_root, key, &depth);
+  else
+    n = find_in_subtree_counted(bt->head, key, &depth);
+
+  BTSTATS_INC(bt, finds);
+  BTSTATS_RECORD(bt, depth, depth);
+  BTSTATS_RECORD(bt, turnstile_wait, entered - start);
+  BTSTATS_RECORD(bt, read_wait, held - entered);
+  BTSTATS_RECORD(bt, read_hold, btstats_now() - held);
+
+  sem_wait(&bt->mutex);
+
+  bt->readers_count--;
+  if(bt->readers_count == 0)
+    sem_post(&bt->read_write);
+
+  sem_post(&bt->mutex);
+
+  return n;
+}
+
+typedef struct _bulk_pair_t {
+  int key;
+  size_t idx;
+} bulk_pair_t;
+
+// Input of a bulk load, order[i] is the index of the i-th
+// smallest key or NULL if the keys were already in order
+typedef struct _bulk_t {
+  bintree_t *bt;
+  int *keys;
+  char **values;
+  size_t *order;
+} bulk_t;
+
+typedef struct _bulk_job_t {
+  bulk_t *bulk;
+  size_t lo;
+  size_t hi;
+  int threads;
+  node_t *root;
+} bulk_job_t;
+
+static int bulk_pair_cmp(const void *a, const void *b)
+{
+  const bulk_pair_t *l = (const bulk_pair_t *)a, *r = (const bulk_pair_t *)b;
+
+  if(l->key != r->key)
+    return l->key < r->key ? -1 : 1;
+  return l->idx < r->idx ? -1 : l->idx > r->idx;
+}
+
+/*
+ * Leaves order NULL if keys is strictly ascending. Otherwise
+ * sorts an index by key and drops all but the last value given
+ * for each key, as inserting them one by one would have.
+ * Returns the number of distinct keys, or 0 if out of memory.
+ */
+static size_t bulk_order(bulk_t *bulk, size_t n)
+{
+  bulk_pair_t *pairs;
+  size_t i, m = 0;
+
+  bulk->order = NULL;
+  for(i = 1; i < n && bulk->keys[i - 1] < bulk->keys[i]; i++)
+    ;
+  if(i >= n)
+    return n;
+
+  pairs = (bulk_pair_t *)malloc(n * sizeof(bulk_pair_t));
+  bulk->order = (size_t *)malloc(n * sizeof(size_t));
+  if(!pairs || !bulk->order)
+  {
+    free(pairs);
+    free(bulk->order);
+    bulk->order = NULL;
+    return 0;
+  }
+
+  for(i = 0; i < n; i++)
+  {
+    pairs[i].key = bulk->keys[i];
+    pairs[i].idx = i;
+  }
+  qsort(pairs, n, sizeof(bulk_pair_t), bulk_pair_cmp);
+
+  for(i = 0; i < n; i++)
+    if(i + 1 == n || pairs[i + 1].key != pairs[i].key)
+      bulk->order[m++] = pairs[i].idx;
+
+  free(pairs);
+  return m;
+}
+
+static node_t* bulk_node(bulk_t *bulk, size_t i)
+{
+  size_t idx = bulk->order ? bulk->order[i] : i;
+
+  if(bulk->bt->flags & BT_ARENA)
+    return bt_new_node(bulk->bt, bulk->keys[idx], bulk->values[idx]);
+  return new_node(bulk->keys[idx], bulk->values[idx]);
+}
+
+// Perfectly balanced subtree over the sorted keys [lo, hi)
+static node_t* bulk_build(bulk_t *bulk, size_t lo, size_t hi)
+{
+  size_t mid = lo + (hi - lo) / 2;
+  node_t *n;
+
+  if(lo >= hi)
+    return NULL;
+
+  n = bulk_node(bulk, mid);
+  n->left = bulk_build(bulk, lo, mid);
+  n->right = bulk_build(bulk, mid + 1, hi);
+  update_height(n);
+
+  return n;
+}
+
+static node_t* bulk_build_parallel(bulk_t *bulk, size_t lo, size_t hi, int threads);
+
+static void* bulk_build_job(void *arg)
+{
+  bulk_job_t *job = (bulk_job_t *)arg;
+
+  job->root = bulk_build_parallel(job->bulk, job->lo, job->hi, job->threads);
+  return NULL;
+}
+
+/*
+ * Like bulk_build, but the left subtree goes to a new thread
+ * with half of the threads while the caller builds the right
+ * one, until subtrees get smaller than BT_BULK_SPLIT_MIN
+ */
+static node_t* bulk_build_parallel(bulk_t *bulk, size_t lo, size_t hi, int threads)
+{
+  size_t mid = lo + (hi - lo) / 2;
+  bulk_job_t job = { bulk, lo, mid, threads / 2, NULL };
+  pthread_t thread;
+  int spawned;
+  node_t *n;
+
+  if(threads < 2 || hi - lo < 2 * (size_t)BT_BULK_SPLIT_MIN)
+    return bulk_build(bulk, lo, hi);
+
+  n = bulk_node(bulk, mid);
+  spawned = !pthread_create(&thread, NULL, bulk_build_job, &job);
+
+  n->right = bulk_build_parallel(bulk, mid + 1, hi, threads - threads / 2);
+  if(spawned)
+    pthread_join(thread, NULL);
+  else
+    bulk_build_job(&job);
+
+  n->left = job.root;
+  update_height(n);
+
+  return n;
+}
+
+// True if bt holds no keys. bp_remove never merges, so emptied
+// B+-trees keep their inner nodes and leaves.
+static int bt_empty(bintree_t *bt)
+{
+  bp_node_t *leaf;
+
+  if(!(bt->flags & BT_BPLUS))
+    return !bt->head;
+
+  for(leaf = bp_first_leaf(bt->bp_root); leaf; leaf = leaf->next)
+    if(leaf->n)
+      return 0;
+  return 1;
+}
+
+// B+-tree and lock-free engines build on a sorted node array
+static int bulk_load_nodes(bintree_t *bt, bulk_t *bulk, size_t m)
+{
+  node_t **nodes = (node_t **)malloc(m * sizeof(node_t *));
+  bp_node_t *bp_root = NULL;
+  size_t i;
+  int ret;
+
+  if(!nodes)
+    return -1;
+
+  for(i = 0; i < m; i++)
+    nodes[i] = bulk_node(bulk, i);
+
+  if(bt->flags & BT_LOCKFREE)
+    ret = lf_build(bt->lf, nodes, m);
+  else if(!(bp_root = bp_build(nodes, m)))
+    ret = -1;
+  else
+  {
+    sem_wait(&bt->turnstile);
+    sem_wait(&bt->read_write);
+
+    ret = bt_empty(bt) ? 0 : -1;
+    if(ret == 0)
+    {
+      bp_free(bt->bp_root, 0);
+      bt->bp_root = bp_root;
+    }
+
+    sem_post(&bt->read_write);
+    sem_post(&bt->turnstile);
+
+    if(ret)
+      bp_free(bp_root, 0);
+  }
+
+  for(i = 0; i < m && ret; i++)
+    free_node(nodes[i]);
+  free(nodes);
+
+  return ret;
+}
+
+static int bulk_load_tree(bintree_t *bt, bulk_t *bulk, size_t m, int threads)
+{
+  node_t *root = bulk_build_parallel(bulk, 0, m, threads);
+  int ret;
+
+  if(bt->flags & BT_FINE_LOCK)
+  {
+    rw_write_lock(&bt->head_lock);
+    ret = bt_empty(bt) ? 0 : -1;
+    if(ret == 0)
+      bt->head = root;
+    rw_write_unlock(&bt->head_lock);
+  }
+  else
+  {
+    sem_wait(&bt->turnstile);
+    sem_wait(&bt->read_write);
+    ret = bt_empty(bt) ? 0 : -1;
+    if(ret == 0)
+      bt->head = root;
+    sem_post(&bt->read_write);
+    sem_post(&bt->turnstile);
+  }
+
+  if(ret)
+    free_subtree(root);
+  return ret;
+}
+
+/*
+ * Loads n keys and copies of their values into the empty tree bt,
+ * see bt_bulk_load_threads
+ */
+int bt_bulk_load(bintree_t *bt, int *keys, char **values, size_t n)
+{
+  return bt_bulk_load_threads(bt, keys, values, n, 1);
+}
+
+/*
+ * Loads n keys and copies of their values into the empty tree bt
+ * in O(n) if keys are ascending, O(n log n) if they need sorting.
+ * The tree is built privately, node trees with up to threads
+ * threads, and published in a single lock acquisition, so
+ * readers only wait for the swap. Returns -1 if bt isn't empty,
+ * leaving it untouched.
+ */
+int bt_bulk_load_threads(bintree_t *bt, int *keys, char **values, size_t n, int threads)
+{
+  bulk_t bulk = { bt, keys, values, NULL };
+  size_t m;
+  int ret;
+
+  if(!bt || (n && (!keys || !values)))
+    return -1;
+  if(n == 0)
+    return 0;
+  if(!(m = bulk_order(&bulk, n)))
+    return -1;
+
+  if(bt->flags & (BT_BPLUS | BT_LOCKFREE))
+    ret = bulk_load_nodes(bt, &bulk, m);
+  else
+    ret = bulk_load_tree(bt, &bulk, m, threads);
+  free(bulk.order);
+
+  BTSTATS_ONLY(if(ret == 0) btstats_add(&bt->stats.inserts, m);)
+  return ret;
+}
+
+// Reader side of the tree's semaphores, as taken by find
+static void read_lock(bintree_t *bt)
+{
+  sem_wait(&bt->turnstile);
+  sem_post(&bt->turnstile);
+
+  sem_wait(&bt->mutex);
+  bt->readers_count++;
+  if(bt->readers_count == 1)
+    sem_wait(&bt->read_write);
+  sem_post(&bt->mutex);
+}
+
+static void read_unlock(bintree_t *bt)
+{
+  sem_wait(&bt->mutex);
+  bt->readers_count--;
+  if(bt->readers_count == 0)
+    sem_post(&bt->read_write);
+  sem_post(&bt->mutex);
+}
+
+// Grows the stack on demand, unbalanced trees can be deep
+int bt_iter_push(bt_iter_t *it, void *n)
+{
+  if(it->top == it->cap)
+  {
+    size_t cap = it->cap ? it->cap * 2 : BT_MAX_HEIGHT;
+    void **stack = (void **)realloc(it->stack, cap * sizeof(void *));
+
+    if(!stack)
+    {
+      it->failed = 1;
+      return -1;
+    }
+    it->stack = stack;
+    it->cap = cap;
+  }
+
+  it->stack[it->top++] = n;
+  return 0;
+}
+
+/*
+ * Pushes the nodes with key >= lo on the path from n towards lo,
+ * so the stack top is the smallest of them. BT_FINE_LOCK trees
+ * read lock down the path and keep the pushed nodes locked, so
+ * writers already inside the tree can't unlink them.
+ */
+static void iter_push_path(bt_iter_t *it, node_t *n, int lo)
+{
+  int fine = it->bt->flags & BT_FINE_LOCK;
+  node_t *passed = NULL, *next;
+
+  while(n)
+  {
+    if(fine)
+    {
+      rw_read_lock(&n->lock);
+      if(passed)
+        rw_read_unlock(&passed->lock);
+    }
+
+    passed = NULL;
+    next = n->key < lo ? n->right : n->left;
+    if(n->key < lo || bt_iter_push(it, n))
+      passed = n;
+    if(it->failed)
+      break;
+    n = next;
+  }
+
+  if(fine && passed)
+    rw_read_unlock(&passed->lock);
+}
+
+// Successor of the last node returned, whose right subtree is
+// only pushed now
+static node_t* iter_next_node(bt_iter_t *it)
+{
+  node_t *n = it->cur;
+
+  if(n)
+  {
+    it->cur = NULL;
+    iter_push_path(it, n->right, INT_MIN);
+    if(it->bt->flags & BT_FINE_LOCK)
+      rw_read_unlock(&n->lock);
+  }
+
+  if(!it->top || it->failed)
+    return NULL;
+
+  it->cur = (node_t *)it->stack[--it->top];
+  return it->cur;
+}
+
+static node_t* iter_next_leaf(bt_iter_t *it)
+{
+  while(it->leaf && it->pos == it->leaf->n)
+  {
+    it->leaf = it->leaf->next;
+    it->pos = 0;
+  }
+  return it->leaf ? it->leaf->ptr.vals[it->pos++] : NULL;
+}
+
+/*
+ * Positions it before the first key >= lo of bt, holding the read
+ * side of the tree until bt_iter_release: the semaphores, head_lock
+ * of BT_FINE_LOCK trees or an epoch of BT_LOCKFREE ones. Writers
+ * wait for it, so the thread holding it must not modify bt.
+ * Returns -1 if the stack can't be allocated, nothing is held then.
+ */
+int bt_iter_seek(bt_iter_t *it, bintree_t *bt, int lo, int hi)
+{
+  if(!it || !bt)
+    return -1;
+
+  memset(it, 0, sizeof(bt_iter_t));
+  it->bt = bt;
+  it->lo = lo;
+  it->hi = hi;
+  it->done = lo > hi;
+  if(it->done)
+    return 0;
+
+  if(bt->flags & BT_LOCKFREE)
+    it->epoch = lf_iter_seek(bt->lf, lo, it);
+  else if(bt->flags & BT_FINE_LOCK)
+  {
+    rw_read_lock(&bt->head_lock);
+    iter_push_path(it, bt->head, lo);
+  }
+  else
+  {
+    read_lock(bt);
+    if(bt->flags & BT_BPLUS)
+      it->leaf = bp_seek(bt->bp_root, lo, &it->pos);
+    else
+      iter_push_path(it, bt->head, lo);
+  }
+  it->held = 1;
+
+  if(it->failed)
+  {
+    bt_iter_release(it);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Next node in key order, or NULL past hi. NULL with it->failed
+ * set means the scan stopped early, bt_iter_resume retries it.
+ * Nodes of BT_LOCKFREE trees may be removed meanwhile, as with find.
+ */
+node_t* bt_iter_next(bt_iter_t *it)
+{
+  node_t *n;
+  int key = 0;
+
+  if(!it || !it->held || it->done)
+    return NULL;
+
+  // Lock-free seeks end on a leaf that may be below lo, and
+  // concurrent removals may bring back keys already returned
+  do
+  {
+    if(it->bt->flags & BT_LOCKFREE)
+      n = lf_iter_next(it, &key);
+    else if((n = it->bt->flags & BT_BPLUS ? iter_next_leaf(it) : iter_next_node(it)))
+      key = n->key;
+  } while(n && key < it->lo);
+
+  if(!n || key > it->hi)
+  {
+    it->done = !it->failed;
+    return NULL;
+  }
+
+  if(key == INT_MAX)
+    it->done = 1;
+  else
+    it->lo = key + 1;
+  return n;
+}
+
+// Drops what bt_iter_seek took, it can still be resumed
+void bt_iter_release(bt_iter_t *it)
+{
+  bintree_t *bt;
+
+  if(!it || !it->held)
+    return;
+  bt = it->bt;
+
+  if(bt->flags & BT_LOCKFREE)
+    lf_iter_release(bt->lf, it->epoch);
+  else if(bt->flags & BT_FINE_LOCK)
+  {
+    if(it->cur)
+      rw_read_unlock(&it->cur->lock);
+    while(it->top)
+      rw_read_unlock(&((node_t *)it->stack[--it->top])->lock);
+    rw_read_unlock(&bt->head_lock);
+  }
+  else
+    read_unlock(bt);
+
+  free(it->stack);
+  it->stack = NULL;
+  it->top = 0;
+  it->cap = 0;
+  it->cur = NULL;
+  it->leaf = NULL;
+  it->held = 0;
+}
+
+/*
+ * Seeks again right after the last key returned, for paginated
+ * scans that release the tree between pages. Keys inserted or
+ * removed meanwhile are seen as of the new seek.
+ */
+int bt_iter_resume(bt_iter_t *it)
+{
+  if(!it || !it->bt)
+    return -1;
+
+  bt_iter_release(it);
+  if(it->done)
+    return 0;
+  return bt_iter_seek(it, it->bt, it->lo, it->hi);
+}
+
+/*
+ * Calls fn on every node with lo <= key <= hi in key order, taking
+ * the tree's read side once for the whole range. Returns fn's value
+ * if it stopped the scan, 0 once hi is passed and -1 on errors.
+ * fn runs with the read side held, so it must not modify bt.
+ */
+int bt_range(bintree_t *bt, int lo, int hi, bt_range_fn fn, void *ctx)
+{
+  bt_iter_t it;
+  node_t *n;
+  int ret = 0;
+
+  if(!fn || bt_iter_seek(&it, bt, lo, hi))
+    return -1;
+
+  while(!ret && (n = bt_iter_next(&it)))
+    ret = fn(n, ctx);
+  if(!ret && it.failed)
+    ret = -1;
+
+  bt_iter_release(&it);
+  return ret;
+}
+
+int bt_stats(bintree_t *bt, bt_stats_t *stats)
+{
+  if(!bt || !stats)
+    return -1;
+
+#ifdef TSDS_STATS
+  btstats_copy(stats, &bt->stats);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+// Clears bt's own counters, a no-op unless built with TSDS_STATS
+void bt_stats_reset(bintree_t *bt)
+{
+#ifdef TSDS_STATS
+  if(bt)
+    btstats_reset(&bt->stats);
+#else
+  (void)bt;
+#endif
+}
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/bplus.h"
+
+/*
+ * Index of the first key >= key. The halving loop has a fixed
+ * trip count for a given n and compiles to conditional moves,
+ * so there are no mispredicted branches on random keys.
+ */
+static int lower_bound(const int *keys, int n, int key)
+{
+  const int *base = keys;
+
+  if(n == 0)
+    return 0;
+
+  while(n > 1)
+  {
+    int half = n / 2;
+    base = base[half - 1] < key ? base + half : base;
+    n -= half;
+  }
+
+  return (int)(base - keys) + (*base < key);
+}
+
+// Index of the first key > key, i.e. the child holding key
+static int upper_bound(const int *keys, int n, int key)
+{
+  const int *base = keys;
+
+  if(n == 0)
+    return 0;
+
+  while(n > 1)
+  {
+    int half = n / 2;
+    base = base[half - 1] <= key ? base + half : base;
+    n -= half;
+  }
+
+  return (int)(base - keys) + (*base <= key);
+}
+
+static bp_node_t* new_bp_node(int leaf)
+{
+  bp_node_t *node = (bp_node_t *)malloc(sizeof(bp_node_t));
+
+  if(node)
+  {
+    node->leaf = leaf;
+    node->n = 0;
+    node->next = NULL;
+  }
+  return node;
+}
+
+/*
+ * Adds key/child at pos of a full inner node, moves the upper
+ * half into right, an empty inner node, and returns it. The
+ * separator for the sibling is stored in *up.
+ */
+static bp_node_t* split_inner(bp_node_t *node, int pos, int key, bp_node_t *child, int *up,
+                              bp_node_t *right)
+{
+  int keys[BT_BP_ORDER + 1];
+  bp_node_t *children[BT_BP_ORDER + 2];
+  int mid = (BT_BP_ORDER + 1) / 2;
+
+  memcpy(keys, node->keys, pos * sizeof(int));
+  keys[pos] = key;
+  memcpy(keys + pos + 1, node->keys + pos, (BT_BP_ORDER - pos) * sizeof(int));
+
+  memcpy(children, node->ptr.children, (pos + 1) * sizeof(bp_node_t *));
+  children[pos + 1] = child;
+  memcpy(children + pos + 2, node->ptr.children + pos + 1, (BT_BP_ORDER - pos) * sizeof(bp_node_t *));
+
+  node->n = mid;
+  memcpy(node->keys, keys, mid * sizeof(int));
+  memcpy(node->ptr.children, children, (mid + 1) * sizeof(bp_node_t *));
+
+  *up = keys[mid];
+
+  right->n = BT_BP_ORDER - mid;
+  memcpy(right->keys, keys + mid + 1, right->n * sizeof(int));
+  memcpy(right->ptr.children, children + mid + 1, (right->n + 1) * sizeof(bp_node_t *));
+
+  return right;
+}
+
+// Same as split_inner for a full leaf, *up is the sibling's first key
+static bp_node_t* split_leaf(bp_node_t *leaf, int pos, node_t *n, int *up, bp_node_t *right)
+{
+  int keys[BT_BP_ORDER + 1];
+  node_t *vals[BT_BP_ORDER + 1];
+  int mid = (BT_BP_ORDER + 1) / 2;
+
+  memcpy(keys, leaf->keys, pos * sizeof(int));
+  keys[pos] = n->key;
+  memcpy(keys + pos + 1, leaf->keys + pos, (BT_BP_ORDER - pos) * sizeof(int));
+
+  memcpy(vals, leaf->ptr.vals, pos * sizeof(node_t *));
+  vals[pos] = n;
+  memcpy(vals + pos + 1, leaf->ptr.vals + pos, (BT_BP_ORDER - pos) * sizeof(node_t *));
+
+  leaf->n = mid;
+  memcpy(leaf->keys, keys, mid * sizeof(int));
+  memcpy(leaf->ptr.vals, vals, mid * sizeof(node_t *));
+
+  right->n = BT_BP_ORDER + 1 - mid;
+  memcpy(right->keys, keys + mid, right->n * sizeof(int));
+  memcpy(right->ptr.vals, vals + mid, right->n * sizeof(node_t *));
+
+  right->next = leaf->next;
+  leaf->next = right;
+  *up = right->keys[0];
+
+  return right;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Inserts n. A node with the same key is replaced and returned
+ * in *old, the caller recycles it. Full nodes are split on the
+ * way back up, so the tree only grows at the root. Every node a
+ * split needs is allocated first, so on -1, when one can't be,
+ * the tree is left as it was.
+ */
+int bp_insert(bp_node_t **root, node_t *n, uint64_t *depth, node_t **old)
+{
+  bp_node_t *path[BT_BP_MAX_HEIGHT];
+  int idx[BT_BP_MAX_HEIGHT];
+  bp_node_t *spare[BT_BP_MAX_HEIGHT + 1];
+  bp_node_t *node = *root, *sibling;
+  int top = 0, pos, up, splits, i;
+
+  if(!node)
+  {
+    if(!(node = new_bp_node(1)))
+      return -1;
+    *root = node;
+  }
+
+  while(!node->leaf)
+  {
+    pos = upper_bound(node->keys, node->n, n->key);
+    path[top] = node;
+    idx[top++] = pos;
+    node = node->ptr.children[pos];
+  }
+  *depth = (uint64_t)top + 1;
+
+  pos = lower_bound(node->keys, node->n, n->key);
+  if(pos < node->n && node->keys[pos] == n->key)
+  {
+    if(node->ptr.vals[pos] != n)
+      *old = node->ptr.vals[pos];
+    node->ptr.vals[pos] = n;
+    return 0;
+  }
+
+  if(node->n < BT_BP_ORDER)
+  {
+    memmove(node->keys + pos + 1, node->keys + pos, (node->n - pos) * sizeof(int));
+    memmove(node->ptr.vals + pos + 1, node->ptr.vals + pos, (node->n - pos) * sizeof(node_t *));
+    node->keys[pos] = n->key;
+    node->ptr.vals[pos] = n;
+    node->n++;
+    return 0;
+  }
+
+  // The leaf, each full ancestor above it and, if they are all
+  // full, a new root take one node apiece
+  for(splits = 1; splits <= top && path[top - splits]->n == BT_BP_ORDER; splits++)
+    ;
+  if(splits > top)
+    splits++;
+  for(i = 0; i < splits; i++)
+    if(!(spare[i] = new_bp_node(i == 0)))
+    {
+      while(i-- > 0)
+        free(spare[i]);
+      return -1;
+    }
+
+  sibling = split_leaf(node, pos, n, &up, spare[0]);
+
+  for(i = 1; top-- > 0; i++)
+  {
+    node = path[top];
+    pos = idx[top];
+
+    if(node->n < BT_BP_ORDER)
+    {
+      memmove(node->keys + pos + 1, node->keys + pos, (node->n - pos) * sizeof(int));
+      memmove(node->ptr.children + pos + 2, node->ptr.children + pos + 1,
+              (node->n - pos) * sizeof(bp_node_t *));
+      node->keys[pos] = up;
+      node->ptr.children[pos + 1] = sibling;
+      node->n++;
+      return 0;
+    }
+
+    sibling = split_inner(node, pos, up, sibling, &up, spare[i]);
+  }
+
+  node = spare[i];
+  node->n = 1;
+  node->keys[0] = up;
+  node->ptr.children[0] = *root;
+  node->ptr.children[1] = sibling;
+  *root = node;
+
+  return 0;
+}
+
+/*
+ * NOT THREAD SAFE
+ */
+node_t* bp_find(bp_node_t *root, int key, uint64_t *depth)
+{
+  bp_node_t *node = root;
+  int pos;
+
+  if(!node)
+    return NULL;
+
+  while(!node->leaf)
+  {
+    node = node->ptr.children[upper_bound(node->keys, node->n, key)];
+    (*depth)++;
+  }
+  (*depth)++;
+
+  pos = lower_bound(node->keys, node->n, key);
+  if(pos < node->n && node->keys[pos] == key)
+    return node->ptr.vals[pos];
+
+  return NULL;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Unlinks key from its leaf and returns its node. Leaves are
+ * never merged: separators stay valid bounds for whatever keys
+ * remain, and emptied leaves are refilled by later inserts.
+ */
+node_t* bp_remove(bp_node_t *root, int key)
+{
+  bp_node_t *node = root;
+  node_t *victim;
+  int pos;
+
+  if(!node)
+    return NULL;
+
+  while(!node->leaf)
+    node = node->ptr.children[upper_bound(node->keys, node->n, key)];
+
+  pos = lower_bound(node->keys, node->n, key);
+  if(pos == node->n || node->keys[pos] != key)
+    return NULL;
+
+  victim = node->ptr.vals[pos];
+  memmove(node->keys + pos, node->keys + pos + 1, (node->n - pos - 1) * sizeof(int));
+  memmove(node->ptr.vals + pos, node->ptr.vals + pos + 1, (node->n - pos - 1) * sizeof(node_t *));
+  node->n--;
+
+  return victim;
+}
+
+/*
+ * NOT THREAD SAFE
+ */
+bp_node_t* bp_first_leaf(bp_node_t *root)
+{
+  while(root && !root->leaf)
+    root = root->ptr.children[0];
+  return root;
+}
+
+// Leaf holding the first key >= key, and its index in *pos, which
+// is past the leaf's keys if they are all smaller
+bp_node_t* bp_seek(bp_node_t *root, int key, int *pos)
+{
+  bp_node_t *node = root;
+
+  if(!node)
+    return NULL;
+
+  while(!node->leaf)
+    node = node->ptr.children[upper_bound(node->keys, node->n, key)];
+
+  *pos = lower_bound(node->keys, node->n, key);
+  return node;
+}
+
+// Frees the partly built forest level[from, to) of bp_build
+static void free_forest(bp_node_t **level, size_t from, size_t to)
+{
+  for(; from < to; from++)
+    bp_free(level[from], 0);
+}
+
+/*
+ * Builds a tree over n nodes sorted by unique key in O(n). Each
+ * level is split into as few nodes as possible and the entries
+ * spread evenly, so every node is at least half full. Returns
+ * NULL for n == 0 or if a node can't be allocated, the node_t
+ * are left to the caller.
+ */
+bp_node_t* bp_build(node_t **nodes, size_t n)
+{
+  size_t count = (n + BT_BP_ORDER - 1) / BT_BP_ORDER, groups, i, j, k;
+  bp_node_t **level, *root = NULL;
+  int *mins;
+
+  if(n == 0)
+    return NULL;
+
+  level = (bp_node_t **)malloc(count * sizeof(bp_node_t *));
+  mins = (int *)malloc(count * sizeof(int));
+
+  for(i = 0, k = 0; level && mins && i < count; i++)
+  {
+    bp_node_t *leaf = new_bp_node(1);
+
+    if(!leaf)
+    {
+      free_forest(level, 0, i);
+      count = 0;
+      break;
+    }
+
+    leaf->n = (int)(n / count + (i < n % count));
+    for(j = 0; j < (size_t)leaf->n; j++, k++)
+    {
+      leaf->keys[j] = nodes[k]->key;
+      leaf->ptr.vals[j] = nodes[k];
+    }
+    if(i > 0)
+      level[i - 1]->next = leaf;
+    level[i] = leaf;
+    mins[i] = leaf->keys[0];
+  }
+
+  // Each pass writes its parents over the front of the arrays
+  while(level && mins && count > 1)
+  {
+    groups = (count + BT_BP_ORDER) / (BT_BP_ORDER + 1);
+
+    for(i = 0, k = 0; i < groups; i++)
+    {
+      bp_node_t *inner = new_bp_node(0);
+      size_t children = count / groups + (i < count % groups);
+      int min = mins[k];
+
+      if(!inner)
+      {
+        free_forest(level, 0, i);
+        free_forest(level, k, count);
+        groups = 0;
+        break;
+      }
+
+      inner->n = (int)children - 1;
+      for(j = 0; j < children; j++, k++)
+      {
+        inner->ptr.children[j] = level[k];
+        if(j > 0)
+          inner->keys[j - 1] = mins[k];
+      }
+      level[i] = inner;
+      mins[i] = min;
+    }
+    count = groups;
+  }
+
+  if(level && mins && count == 1)
+    root = level[0];
+
+  free(level);
+  free(mins);
+  return root;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Frees the nodes and, with free_nodes, their node_t. Recursion
+ * depth is the tree height, at most BT_BP_MAX_HEIGHT.
+ */
+void bp_free(bp_node_t *root, int free_nodes)
+{
+  int i;
+
+  if(!root)
+    return;
+
+  if(root->leaf)
+  {
+    for(i = 0; i < root->n && free_nodes; i++)
+      free_node(root->ptr.vals[i]);
+  }
+  else
+  {
+    for(i = 0; i <= root->n; i++)
+      bp_free(root->ptr.children[i], free_nodes);
+  }
+
+  free(root);
+}
@@ -0,0 +1,85 @@
+#include <time.h>
+#include "../headers/btstats.h"
+
+uint64_t btstats_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Readers update stats concurrently, so every counter is atomic
+void btstats_add(uint64_t *counter, uint64_t n)
+{
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+static int bucket_of(uint64_t v)
+{
+  int bucket;
+
+  if(v == 0)
+    return 0;
+
+  bucket = 64 - __builtin_clzll(v);
+  return bucket < BT_HIST_BUCKETS ? bucket : BT_HIST_BUCKETS - 1;
+}
+
+void btstats_record(bt_hist_t *hist, uint64_t v)
+{
+  uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+
+  btstats_add(&hist->count, 1);
+  btstats_add(&hist->sum, v);
+  btstats_add(&hist->buckets[bucket_of(v)], 1);
+
+  while(v > max &&
+        !__atomic_compare_exchange_n(&hist->max, &max, v, 1,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/*
+ * Not an atomic snapshot of all counters,
+ * but no single counter is ever torn
+ */
+void btstats_copy(bt_stats_t *dst, bt_stats_t *src)
+{
+  uint64_t *from = (uint64_t *)src;
+  uint64_t *to = (uint64_t *)dst;
+  size_t i;
+
+  for(i = 0; i < sizeof(bt_stats_t) / sizeof(uint64_t); i++)
+    to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+}
+
+void btstats_reset(bt_stats_t *stats)
+{
+  uint64_t *counters = (uint64_t *)stats;
+  size_t i;
+
+  for(i = 0; i < sizeof(bt_stats_t) / sizeof(uint64_t); i++)
+    __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+}
+
+// Upper bound of the p-th (0 < p <= 1) percentile, 0 if empty
+uint64_t btstats_percentile(const bt_hist_t *hist, double p)
+{
+  uint64_t rank, seen = 0;
+  int i;
+
+  if(hist->count == 0)
+    return 0;
+
+  rank = (uint64_t)(p * (double)hist->count);
+  if(rank == 0)
+    rank = 1;
+
+  for(i = 0; i < BT_HIST_BUCKETS - 1; i++)
+  {
+    seen += hist->buckets[i];
+    if(seen >= rank)
+      return i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+  }
+  return hist->max;
+}
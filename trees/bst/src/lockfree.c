@@ -0,0 +1,560 @@
+#include <limits.h>
+#include <stdlib.h>
+#include "../headers/lockfree.h"
+
+#define LF_FLAG ((uintptr_t)1) // Edge to a leaf being removed
+#define LF_TAG  ((uintptr_t)2) // Edge that must not change anymore
+
+#define LF_INF0 ((int64_t)INT_MAX + 1)
+#define LF_INF1 ((int64_t)INT_MAX + 2)
+#define LF_INF2 ((int64_t)INT_MAX + 3)
+
+typedef struct _lf_seek_t {
+  lf_node_t *ancestor;  // Last node reached over an untagged edge...
+  lf_node_t *successor; // ...and its child on the path
+  lf_node_t *parent;
+  lf_node_t *leaf;
+} lf_seek_t;
+
+static __thread int lf_stripe = -1;
+static int lf_next_stripe;
+
+static lf_node_t* addr(uintptr_t edge)
+{
+  return (lf_node_t *)(edge & ~(LF_FLAG | LF_TAG));
+}
+
+static uintptr_t load_edge(uintptr_t *edge)
+{
+  return __atomic_load_n(edge, __ATOMIC_ACQUIRE);
+}
+
+static int cas_edge(uintptr_t *edge, uintptr_t expected, uintptr_t desired)
+{
+  return __atomic_compare_exchange_n(edge, &expected, desired, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static lf_node_t* new_lf_node(int64_t key, node_t *n, lf_node_t *left, lf_node_t *right)
+{
+  lf_node_t *node = (lf_node_t *)malloc(sizeof(lf_node_t));
+
+  if(node)
+  {
+    node->key = key;
+    node->node = n;
+    node->left = (uintptr_t)left;
+    node->right = (uintptr_t)right;
+    node->retired_next = NULL;
+  }
+  return node;
+}
+
+static lf_stripe_t* my_stripe(lf_tree_t *lf)
+{
+  if(lf_stripe < 0)
+    lf_stripe = __atomic_fetch_add(&lf_next_stripe, 1, __ATOMIC_RELAXED) % BT_LF_STRIPES;
+  return &lf->stripes[lf_stripe];
+}
+
+/*
+ * Announces the caller in the current epoch, returns it for
+ * epoch_exit. Rechecking the epoch after the increment makes
+ * sure it can't have moved on before the caller was counted.
+ */
+static uint64_t epoch_enter(lf_tree_t *lf)
+{
+  lf_stripe_t *stripe = my_stripe(lf);
+  uint64_t e;
+
+  for(;;)
+  {
+    e = __atomic_load_n(&lf->epoch, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&stripe->active[e & 1], 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&lf->epoch, __ATOMIC_SEQ_CST) == e)
+      return e;
+    __atomic_fetch_sub(&stripe->active[e & 1], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void epoch_exit(lf_tree_t *lf, uint64_t e)
+{
+  __atomic_fetch_sub(&my_stripe(lf)->active[e & 1], 1, __ATOMIC_RELEASE);
+}
+
+// Retired nodes only hold a node_t that insert replaced, which
+// goes back to the owner unless lf is NULL
+static void free_list(lf_tree_t *lf, lf_node_t *node)
+{
+  while(node)
+  {
+    lf_node_t *next = node->retired_next;
+    if(node->node && lf && lf->release)
+      lf->release(lf->owner, node->node);
+    else
+      free_node(node->node);
+    free(node);
+    node = next;
+  }
+}
+
+/*
+ * Moves the epoch from e to e + 1 once nobody is left in e - 1.
+ * Threads still in e entered after everything retired in e - 1
+ * was unlinked, so that list can be freed.
+ */
+static void epoch_try_advance(lf_tree_t *lf)
+{
+  uint64_t e = __atomic_load_n(&lf->epoch, __ATOMIC_SEQ_CST);
+  int i;
+
+  for(i = 0; i < BT_LF_STRIPES; i++)
+    if(__atomic_load_n(&lf->stripes[i].active[(e + 1) & 1], __ATOMIC_SEQ_CST))
+      return;
+
+  if(!__atomic_compare_exchange_n(&lf->epoch, &e, e + 1, 0,
+                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    return;
+
+  free_list(lf, __atomic_exchange_n(&lf->retired[(e + 2) % 3], NULL, __ATOMIC_ACQ_REL));
+}
+
+// Must be called between epoch_enter and epoch_exit
+static void retire(lf_tree_t *lf, lf_node_t *node)
+{
+  uint64_t e = __atomic_load_n(&lf->epoch, __ATOMIC_SEQ_CST);
+  lf_node_t **head = &lf->retired[e % 3];
+
+  node->retired_next = __atomic_load_n(head, __ATOMIC_RELAXED);
+  while(!__atomic_compare_exchange_n(head, &node->retired_next, node, 1,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  if(__atomic_add_fetch(&lf->retires, 1, __ATOMIC_RELAXED) % BT_LF_RETIRE_SCAN == 0)
+    epoch_try_advance(lf);
+}
+
+lf_tree_t* lf_create(lf_release_fn release, void *owner)
+{
+  lf_tree_t *lf = (lf_tree_t *)calloc(1, sizeof(lf_tree_t));
+  lf_node_t *s;
+
+  if(!lf)
+    return NULL;
+
+  lf->release = release;
+  lf->owner = owner;
+  s = new_lf_node(LF_INF1, NULL, new_lf_node(LF_INF0, NULL, NULL, NULL),
+                                 new_lf_node(LF_INF1, NULL, NULL, NULL));
+  lf->root = new_lf_node(LF_INF2, NULL, s, new_lf_node(LF_INF2, NULL, NULL, NULL));
+
+  return lf;
+}
+
+static void seek(lf_tree_t *lf, int key, lf_seek_t *rec)
+{
+  uintptr_t parent_field, current_field;
+  lf_node_t *current;
+
+  rec->ancestor = lf->root;
+  rec->successor = addr(lf->root->left);
+  rec->parent = rec->successor;
+
+  parent_field = load_edge(&rec->parent->left);
+  rec->leaf = addr(parent_field);
+  current_field = load_edge(key < rec->leaf->key ? &rec->leaf->left : &rec->leaf->right);
+  current = addr(current_field);
+
+  while(current)
+  {
+    if(!(parent_field & LF_TAG))
+    {
+      rec->ancestor = rec->parent;
+      rec->successor = rec->leaf;
+    }
+    rec->parent = rec->leaf;
+    rec->leaf = current;
+
+    parent_field = current_field;
+    current_field = load_edge(key < current->key ? &current->left : &current->right);
+    current = addr(current_field);
+  }
+}
+
+/*
+ * Frees what a successful cleanup unlinked: the path from the
+ * successor down to the parent, each with its flagged leaf. Only
+ * kept, the sibling moved up to the ancestor, stays.
+ */
+static void retire_path(lf_tree_t *lf, int key, lf_node_t *node, lf_node_t *parent, lf_node_t *kept)
+{
+  for(;;)
+  {
+    lf_node_t *left = addr(load_edge(&node->left));
+    lf_node_t *right = addr(load_edge(&node->right));
+    lf_node_t *next = key < node->key ? left : right;
+
+    if(node == parent)
+    {
+      retire(lf, left == kept ? right : left);
+      retire(lf, node);
+      return;
+    }
+
+    retire(lf, next == left ? right : left);
+    retire(lf, node);
+    node = next;
+  }
+}
+
+/*
+ * Physically removes the flagged leaf found by the last seek
+ * along with its parent. Returns 1 if this call unlinked them.
+ */
+static int cleanup(lf_tree_t *lf, int key, lf_seek_t *rec)
+{
+  uintptr_t *successor_addr, *child_addr, *sibling_addr, sibling;
+
+  successor_addr = key < rec->ancestor->key ? &rec->ancestor->left : &rec->ancestor->right;
+  if(key < rec->parent->key)
+  {
+    child_addr = &rec->parent->left;
+    sibling_addr = &rec->parent->right;
+  }
+  else
+  {
+    child_addr = &rec->parent->right;
+    sibling_addr = &rec->parent->left;
+  }
+
+  // The flagged leaf may be on the other side of the parent
+  if(!(load_edge(child_addr) & LF_FLAG))
+    sibling_addr = child_addr;
+
+  __atomic_fetch_or(sibling_addr, LF_TAG, __ATOMIC_ACQ_REL);
+  sibling = load_edge(sibling_addr);
+
+  if(!cas_edge(successor_addr, (uintptr_t)rec->successor, sibling & ~LF_TAG))
+    return 0;
+
+  retire_path(lf, key, rec->successor, rec->parent, addr(sibling));
+  return 1;
+}
+
+// Helps along a removal blocking the edge to leaf, if any
+static void help(lf_tree_t *lf, int key, lf_seek_t *rec, uintptr_t *child_addr)
+{
+  uintptr_t edge = load_edge(child_addr);
+
+  if(addr(edge) == rec->leaf && (edge & (LF_FLAG | LF_TAG)))
+    cleanup(lf, key, rec);
+}
+
+/*
+ * Inserts n. A node with the same key is replaced and retired
+ * like unlinked tree nodes, so finds still inside an epoch that
+ * got it can read it. Returns -1 if a tree node can't be allocated.
+ */
+int lf_insert(lf_tree_t *lf, node_t *n)
+{
+  lf_node_t *leaf = NULL, *internal = NULL, *carrier = NULL;
+  uintptr_t *child_addr;
+  lf_seek_t rec;
+  int ret = 0;
+  uint64_t e = epoch_enter(lf);
+
+  for(;;)
+  {
+    seek(lf, n->key, &rec);
+    child_addr = n->key < rec.parent->key ? &rec.parent->left : &rec.parent->right;
+
+    if(rec.leaf->key == n->key)
+    {
+      node_t *old = __atomic_load_n(&rec.leaf->node, __ATOMIC_ACQUIRE);
+
+      // Allocated up front, so a failure leaves the tree unchanged
+      if(!carrier && !(carrier = new_lf_node(n->key, NULL, NULL, NULL)))
+      {
+        ret = -1;
+        break;
+      }
+
+      // A NULL node means the leaf is being removed
+      if(old && __atomic_compare_exchange_n(&rec.leaf->node, &old, n, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+        if(old != n)
+        {
+          carrier->node = old;
+          retire(lf, carrier);
+          carrier = NULL;
+        }
+        break;
+      }
+      help(lf, n->key, &rec, child_addr);
+      continue;
+    }
+
+    if(!leaf && !(leaf = new_lf_node(n->key, n, NULL, NULL)))
+    {
+      ret = -1;
+      break;
+    }
+    if(!internal && !(internal = new_lf_node(0, NULL, NULL, NULL)))
+    {
+      ret = -1;
+      break;
+    }
+
+    if(n->key < rec.leaf->key)
+    {
+      internal->key = rec.leaf->key;
+      internal->left = (uintptr_t)leaf;
+      internal->right = (uintptr_t)rec.leaf;
+    }
+    else
+    {
+      internal->key = n->key;
+      internal->left = (uintptr_t)rec.leaf;
+      internal->right = (uintptr_t)leaf;
+    }
+
+    if(cas_edge(child_addr, (uintptr_t)rec.leaf, (uintptr_t)internal))
+    {
+      leaf = internal = NULL;
+      break;
+    }
+    help(lf, n->key, &rec, child_addr);
+  }
+
+  epoch_exit(lf, e);
+
+  // Never published, so no other thread can have seen them
+  free(leaf);
+  free(internal);
+  free(carrier);
+
+  return ret;
+}
+
+node_t* lf_find(lf_tree_t *lf, int key)
+{
+  node_t *n = NULL;
+  lf_seek_t rec;
+  uint64_t e = epoch_enter(lf);
+
+  seek(lf, key, &rec);
+  if(rec.leaf->key == key)
+    n = __atomic_load_n(&rec.leaf->node, __ATOMIC_ACQUIRE);
+
+  epoch_exit(lf, e);
+  return n;
+}
+
+/*
+ * Flagging the edge to the key's leaf is the linearization point,
+ * the node_t is taken from the leaf right after. If cleanup fails
+ * another thread got in the way, and seeks are repeated until the
+ * leaf is gone from the tree.
+ */
+node_t* lf_remove(lf_tree_t *lf, int key)
+{
+  lf_node_t *leaf = NULL;
+  node_t *victim = NULL;
+  uintptr_t *child_addr;
+  lf_seek_t rec;
+  uint64_t e = epoch_enter(lf);
+
+  for(;;)
+  {
+    seek(lf, key, &rec);
+    child_addr = key < rec.parent->key ? &rec.parent->left : &rec.parent->right;
+
+    if(!leaf)
+    {
+      if(rec.leaf->key != key)
+        break;
+
+      if(cas_edge(child_addr, (uintptr_t)rec.leaf, (uintptr_t)rec.leaf | LF_FLAG))
+      {
+        leaf = rec.leaf;
+        victim = __atomic_exchange_n(&leaf->node, NULL, __ATOMIC_ACQ_REL);
+        if(cleanup(lf, key, &rec))
+          break;
+      }
+      else
+        help(lf, key, &rec, child_addr);
+    }
+    else if(rec.leaf != leaf || cleanup(lf, key, &rec))
+      break;
+  }
+
+  epoch_exit(lf, e);
+  return victim;
+}
+
+// Frees a subtree built by build_range that was never published
+static void free_unpublished(lf_node_t *node)
+{
+  if(node)
+  {
+    free_unpublished(addr(node->left));
+    free_unpublished(addr(node->right));
+    free(node);
+  }
+}
+
+/*
+ * External subtree over nodes[lo, hi], balanced by splitting at
+ * the middle key: leaves left of the split route left.
+ */
+static lf_node_t* build_range(node_t **nodes, size_t lo, size_t hi)
+{
+  lf_node_t *node, *left, *right;
+  size_t mid;
+
+  if(lo == hi)
+    return new_lf_node(nodes[lo]->key, nodes[lo], NULL, NULL);
+
+  mid = lo + (hi - lo + 1) / 2;
+  left = build_range(nodes, lo, mid - 1);
+  right = build_range(nodes, mid, hi);
+  node = new_lf_node(nodes[mid]->key, NULL, left, right);
+
+  if(!left || !right || !node)
+  {
+    free_unpublished(left);
+    free_unpublished(right);
+    free(node);
+    return NULL;
+  }
+  return node;
+}
+
+/*
+ * Builds a subtree over n > 0 nodes sorted by unique key and
+ * publishes it with a single CAS, which only succeeds while the
+ * tree is empty. Returns -1 otherwise and leaves the node_t to
+ * the caller.
+ */
+int lf_build(lf_tree_t *lf, node_t **nodes, size_t n)
+{
+  lf_node_t *s = addr(lf->root->left), *empty, *top;
+  uintptr_t edge = load_edge(&s->left);
+
+  // An empty tree has the INF0 leaf right below S
+  empty = addr(edge);
+  if(edge != (uintptr_t)empty || empty->key != LF_INF0 || empty->left)
+    return -1;
+
+  if(!(top = new_lf_node(LF_INF0, NULL, build_range(nodes, 0, n - 1), empty)))
+    return -1;
+
+  if(!addr(top->left) || !cas_edge(&s->left, edge, (uintptr_t)top))
+  {
+    free_unpublished(addr(top->left));
+    free(top);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * NOT THREAD SAFE
+ * Frees every node by rotating left children up, as the tree
+ * is not balanced. With free_nodes, leaves still holding a
+ * node_t free it too.
+ */
+void lf_free(lf_tree_t *lf, int free_nodes)
+{
+  lf_node_t *node, *next;
+  int i;
+
+  if(!lf)
+    return;
+
+  for(i = 0; i < 3; i++)
+    free_list(NULL, lf->retired[i]);
+
+  node = lf->root;
+  while(node)
+  {
+    if(addr(node->left))
+    {
+      next = addr(node->left);
+      node->left = (uintptr_t)addr(next->right);
+      next->right = (uintptr_t)node;
+    }
+    else
+    {
+      next = addr(node->right);
+      if(node->node && free_nodes)
+        free_node(node->node);
+      free(node);
+    }
+    node = next;
+  }
+
+  free(lf);
+}
+
+/*
+ * Pushes the right subtrees hanging off the path to lo, then the
+ * leaf it ends at, which may hold a smaller key. The scan is not
+ * linearizable, but subtrees moved up by removals keep their
+ * edges, so keys present throughout are all seen. The epoch keeps
+ * every pushed node alive until lf_iter_release.
+ */
+uint64_t lf_iter_seek(lf_tree_t *lf, int lo, bt_iter_t *it)
+{
+  uint64_t e = epoch_enter(lf);
+  lf_node_t *n = lf->root, *left;
+
+  while((left = addr(load_edge(&n->left))))
+  {
+    if(lo < n->key)
+    {
+      if(bt_iter_push(it, addr(load_edge(&n->right))))
+        return e;
+      n = left;
+    }
+    else
+      n = addr(load_edge(&n->right));
+  }
+
+  bt_iter_push(it, n);
+  return e;
+}
+
+// Next live leaf in key order, NULL at the sentinels. Its key is
+// read from the leaf, a removed node_t may be recycled meanwhile.
+node_t* lf_iter_next(bt_iter_t *it, int *key)
+{
+  lf_node_t *n, *left;
+  node_t *node;
+
+  while(it->top)
+  {
+    n = (lf_node_t *)it->stack[--it->top];
+    while((left = addr(load_edge(&n->left))))
+    {
+      if(bt_iter_push(it, addr(load_edge(&n->right))))
+        return NULL;
+      n = left;
+    }
+
+    if(n->key > INT_MAX)
+      return NULL;
+    if((node = __atomic_load_n(&n->node, __ATOMIC_ACQUIRE)))
+    {
+      *key = (int)n->key;
+      return node;
+    }
+  }
+  return NULL;
+}
+
+void lf_iter_release(lf_tree_t *lf, uint64_t e)
+{
+  epoch_exit(lf, e);
+}
@@ -1,4 +1,18 @@
+#include <limits.h>
 #include "../headers/utils.h"
+#include "../headers/bplus.h"
+#include "../headers/lockfree.h"
+
+// B+-trees have no meaningful pre/postorder, every order prints
+// the leaf chain
+static void print_leaves(bp_node_t *leaf)
+{
+  int i;
+
+  for(; leaf; leaf = leaf->next)
+    for(i = 0; i < leaf->n; i++)
+      printf(" %d ", leaf->keys[i]);
+}
 
 void print_subtree_inorder(node_t *n)
 {
@@ -30,6 +44,37 @@ void print_subtree_preorder(node_t *n)
   }
 }
 
+// Keys of lock-free trees are in the leaves, printed in order
+static void print_lf_subtree(lf_node_t *n)
+{
+  lf_node_t *left, *right;
+
+  if(!n)
+    return;
+
+  left = (lf_node_t *)(n->left & ~(uintptr_t)3);
+  right = (lf_node_t *)(n->right & ~(uintptr_t)3);
+
+  if(!left && !right)
+  {
+    if(n->node)
+      printf(" %d ", n->node->key);
+    return;
+  }
+
+  print_lf_subtree(left);
+  print_lf_subtree(right);
+}
+
+// In order walks of every engine go through bt_range, which
+// doesn't recurse on deep unbalanced trees
+static int print_key(node_t *n, void *ctx)
+{
+  (void)ctx;
+  printf(" %d ", n->key);
+  return 0;
+}
+
 void print(bintree_t *bt, traversal order)
 {
   if(bt)
@@ -38,16 +83,22 @@ void print(bintree_t *bt, traversal order)
     {
       printf("preorder : ");
       print_subtree_preorder(bt->head);
+      print_leaves(bp_first_leaf(bt->bp_root));
+      if(bt->lf)
+        print_lf_subtree(bt->lf->root);
     }
     if(order == IN)
     {
       printf("inorder  : ");
-      print_subtree_inorder(bt->head);
+      bt_range(bt, INT_MIN, INT_MAX, print_key, NULL);
     }
     if(order == POST)
     {
       printf("postorder: ");
       print_subtree_postorder(bt->head);
+      print_leaves(bp_first_leaf(bt->bp_root));
+      if(bt->lf)
+        print_lf_subtree(bt->lf->root);
     }
     printf("\n");
   }
@@ -0,0 +1,768 @@
+#include <math.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <check.h>
+#include <pthread.h>
+
+#include "../headers/bintree.h"
+#include "../headers/bplus.h"
+
+/*---------------------------------------*/
+/* Typedefs                              */
+/*---------------------------------------*/
+typedef struct tsds_bt_arg tsds_btarg_t;
+typedef struct tsds_bt_keys tsds_btkeys_t;
+
+/*---------------------------------------*/
+/* Globals                               */
+/*---------------------------------------*/
+bintree_t * bt;
+
+/*---------------------------------------*/
+/* Helper function declarations          */
+/*---------------------------------------*/
+node_t * tsds_bt_node(int key, unsigned int version);
+int tsds_bt_node_ok(node_t * node, int key);
+void tsds_ck_assert_bt_avl_height(bintree_t * bt, size_t n);
+void tsds_ck_assert_bt_reference(int flags);
+void tsds_ck_assert_bt_bulk(int flags);
+void tsds_ck_assert_bt_ordered(int flags);
+void tsds_ck_assert_bt_range(int lo, int hi, int const * keys, int n);
+int tsds_bt_collect(node_t * node, void * ctx);
+void tsds_ck_assert_bt_replace(int flags);
+void tsds_ck_assert_bt_stress(int flags);
+void * tsds_bt_stress(void * arg);
+void * tsds_bt_scan(void * arg);
+int tsds_bt_scan_node(node_t * node, void * ctx);
+
+/*---------------------------------------*/
+/* Test fixtures                         */
+/*---------------------------------------*/
+void
+setup(void)
+{
+  bt = NULL;
+}
+
+void
+teardown(void)
+{
+  free_bt(bt);
+}
+
+/*---------------------------------------*/
+/* Helper function definitions           */
+/*---------------------------------------*/
+#define TSDS_BT_KEYS    512
+#define TSDS_BT_OPS     20000
+#define TSDS_BT_THREADS 4
+#define TSDS_BT_SCANS   40
+#define TSDS_BT_PAGE    64
+
+struct tsds_bt_arg
+{
+  bintree_t * bt;
+  unsigned int seed;
+  int bad;          /* Nodes found with the wrong key or value */
+  int last;         /* Last key a scan returned, or -1        */
+};
+
+struct tsds_bt_keys
+{
+  int keys[TSDS_BT_KEYS + 2];
+  int n;
+  int stop_at;      /* Stops the scan after this many keys, or 0 */
+};
+
+node_t *
+tsds_bt_node(int key, unsigned int version)
+/* Nodes carry their key and a version in the value, so
+** replacing a key also changes the value's length. Arena
+** trees take theirs from bt_new_node.
+**/
+{
+  char value[32];
+  snprintf(value, sizeof(value), "%d:%u", key, version);
+  if (bt && (bt->flags & BT_ARENA))
+    return bt_new_node(bt, key, value);
+  return new_node(key, value);
+}
+
+int
+tsds_bt_node_ok(node_t * node, int key)
+{
+  return node->key == key && atoi(node->value) == key;
+}
+
+void
+tsds_ck_assert_bt_avl_height(bintree_t * bt, size_t n)
+/* An AVL tree of n keys is at most 1.44 * log2(n + 2) high.
+**/
+{
+  ck_assert_ptr_nonnull(bt->head);
+  ck_assert_int_le(bt->head->height, (int)(1.44 * log2((double)n + 2)));
+}
+
+void
+tsds_ck_assert_bt_reference(int flags)
+/* Runs random inserts, replaces, removes and finds on a
+** tree built with flags and checks every result against
+** a plain array of the keys present.
+**/
+{
+  unsigned int present[TSDS_BT_KEYS] = { 0 };
+  unsigned int seed = 7;
+  char value[32];
+  node_t * node;
+  int i, key, op;
+
+  bt_init(&bt, flags);
+
+  for (i = 0; i < TSDS_BT_OPS; i++)
+  {
+    key = rand_r(&seed) % TSDS_BT_KEYS;
+    op = rand_r(&seed) % 3;
+
+    if (op == 0)
+    {
+      ck_assert_int_eq(insert(bt, tsds_bt_node(key, i + 1)), 0);
+      present[key] = i + 1;
+    }
+    else if (op == 1)
+    {
+      ck_assert_int_eq(bt_remove(bt, key), present[key] ? 0 : -1);
+      present[key] = 0;
+    }
+
+    node = find(bt, key);
+    if (!present[key])
+    {
+      ck_assert_ptr_null(node);
+      continue;
+    }
+    ck_assert_ptr_nonnull(node);
+    snprintf(value, sizeof(value), "%d:%u", key, present[key]);
+    ck_assert_str_eq(node->value, value);
+  }
+
+  for (key = 0; key < TSDS_BT_KEYS; key++)
+    ck_assert_int_eq(find(bt, key) != NULL, present[key] != 0);
+}
+
+void
+tsds_ck_assert_bt_replace(int flags)
+/* Replaced nodes must stay readable and only be handed out
+** again by bt_new_node, once it runs out of fresh ones.
+**/
+{
+  node_t * old;
+  int i;
+
+  bt_init(&bt, flags);
+
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+    ck_assert_int_eq(insert(bt, tsds_bt_node(i, 1)), 0);
+
+  old = find(bt, 3);
+  ck_assert_ptr_nonnull(old);
+  ck_assert_int_eq(insert(bt, tsds_bt_node(3, 2)), 0);
+  ck_assert_ptr_ne(find(bt, 3), old);
+  ck_assert_int_eq(old->key, 3);
+  ck_assert_str_eq(old->value, "3:1");
+
+  /* Lock-free trees recycle once the epochs have moved on */
+  if (!(flags & BT_LOCKFREE))
+    ck_assert_ptr_eq(bt_new_node(bt, TSDS_BT_KEYS, "512:1"), old);
+}
+
+void
+tsds_ck_assert_bt_bulk(int flags)
+/* Bulk loads sorted keys, serially and with threads, then
+** unsorted keys with a duplicate, into trees built with
+** flags. Node trees must come out AVL balanced.
+**/
+{
+  static char values_buf[TSDS_BT_KEYS][16];
+  char * values[TSDS_BT_KEYS];
+  int keys[TSDS_BT_KEYS];
+  int unsorted[] = { 5, 3, 9, 3, 1 };
+  char * unsorted_values[] = { "5:1", "3:1", "9:1", "3:2", "1:1" };
+  int * big_keys;
+  char ** big_values;
+  node_t * node;
+  size_t i, n = 2 * BT_BULK_SPLIT_MIN + 3;
+
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+  {
+    keys[i] = (int)i;
+    snprintf(values_buf[i], sizeof(values_buf[i]), "%d:1", (int)i);
+    values[i] = values_buf[i];
+  }
+
+  bt_init(&bt, flags);
+  ck_assert_int_eq(bt_bulk_load(bt, keys, values, 0), 0);
+  ck_assert_int_eq(bt_bulk_load(bt, NULL, values, TSDS_BT_KEYS), -1);
+  ck_assert_int_eq(bt_bulk_load(bt, keys, NULL, TSDS_BT_KEYS), -1);
+  ck_assert_int_eq(bt_bulk_load(bt, keys, values, TSDS_BT_KEYS), 0);
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+  {
+    ck_assert_ptr_nonnull(node = find(bt, (int)i));
+    ck_assert_str_eq(node->value, values[i]);
+  }
+  ck_assert_ptr_null(find(bt, TSDS_BT_KEYS));
+  if (!(flags & (BT_BPLUS | BT_LOCKFREE)))
+    tsds_ck_assert_bt_avl_height(bt, TSDS_BT_KEYS);
+
+  /* Only empty trees are loaded, the tree is left as is */
+  node = find(bt, 0);
+  ck_assert_int_eq(bt_bulk_load(bt, keys, values, 1), -1);
+  ck_assert_ptr_eq(find(bt, 0), node);
+  free_bt(bt);
+  bt = NULL;
+
+  /* Large enough to be split between threads */
+  big_keys = (int *)malloc(n * sizeof(int));
+  big_values = (char **)malloc(n * sizeof(char *));
+  ck_assert_ptr_nonnull(big_keys);
+  ck_assert_ptr_nonnull(big_values);
+  for (i = 0; i < n; i++)
+  {
+    big_keys[i] = 2 * (int)i;
+    big_values[i] = "v";
+  }
+  bt_init(&bt, flags);
+  ck_assert_int_eq(bt_bulk_load_threads(bt, big_keys, big_values, n, 4), 0);
+  for (i = 0; i < n; i++)
+  {
+    ck_assert_ptr_nonnull(find(bt, 2 * (int)i));
+    ck_assert_ptr_null(find(bt, 2 * (int)i + 1));
+  }
+  if (!(flags & (BT_BPLUS | BT_LOCKFREE)))
+    tsds_ck_assert_bt_avl_height(bt, n);
+  free(big_keys);
+  free(big_values);
+  free_bt(bt);
+  bt = NULL;
+
+  /* Unsorted input is sorted, the last value of a key wins */
+  bt_init(&bt, flags);
+  ck_assert_int_eq(bt_bulk_load(bt, unsorted, unsorted_values, 5), 0);
+  ck_assert_str_eq(find(bt, 3)->value, "3:2");
+  for (i = 0; i < 5; i++)
+    ck_assert_int_eq(tsds_bt_node_ok(find(bt, unsorted[i]), unsorted[i]), 1);
+  if (!(flags & (BT_BPLUS | BT_LOCKFREE)))
+    tsds_ck_assert_bt_avl_height(bt, 4);
+}
+
+int
+tsds_bt_collect(node_t * node, void * ctx)
+{
+  tsds_btkeys_t * btkeys = (tsds_btkeys_t *)ctx;
+
+  ck_assert_int_lt(btkeys->n, TSDS_BT_KEYS + 2);
+  ck_assert_int_eq(tsds_bt_node_ok(node, node->key), 1);
+  btkeys->keys[btkeys->n++] = node->key;
+  return btkeys->n == btkeys->stop_at;
+}
+
+void
+tsds_ck_assert_bt_range(int lo, int hi, int const * keys, int n)
+/* Checks that bt_range(bt, lo, hi) visits exactly the n
+** keys given, in order.
+**/
+{
+  tsds_btkeys_t btkeys;
+  int i;
+
+  btkeys.n = 0;
+  btkeys.stop_at = 0;
+  ck_assert_int_eq(bt_range(bt, lo, hi, tsds_bt_collect, &btkeys), 0);
+  ck_assert_int_eq(btkeys.n, n);
+  for (i = 0; i < n; i++)
+    ck_assert_int_eq(btkeys.keys[i], keys[i]);
+}
+
+void
+tsds_ck_assert_bt_ordered(int flags)
+/* Checks bt_range's bounds and early stops, and a paged
+** iteration whose next key is removed between pages, on
+** the even keys below 2 * TSDS_BT_KEYS plus INT_MIN and
+** INT_MAX.
+**/
+{
+  int const keys_10_20[] = { 10, 12, 14, 16, 18, 20 };
+  int const keys_ends[] = { INT_MIN, 0 };
+  int const keys_max[] = { INT_MAX };
+  tsds_btkeys_t btkeys;
+  bt_iter_t it;
+  node_t * node;
+  int i, count, last;
+
+  bt_init(&bt, flags);
+
+  /* Empty tree */
+  tsds_ck_assert_bt_range(INT_MIN, INT_MAX, NULL, 0);
+  ck_assert_int_eq(bt_iter_seek(&it, bt, INT_MIN, INT_MAX), 0);
+  ck_assert_ptr_null(bt_iter_next(&it));
+  bt_iter_release(&it);
+
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+    ck_assert_int_eq(insert(bt, tsds_bt_node(2 * i, 1)), 0);
+  ck_assert_int_eq(insert(bt, tsds_bt_node(INT_MIN, 1)), 0);
+  ck_assert_int_eq(insert(bt, tsds_bt_node(INT_MAX, 1)), 0);
+
+  /* Both bounds are inclusive */
+  tsds_ck_assert_bt_range(10, 20, keys_10_20, 6);
+  tsds_ck_assert_bt_range(9, 21, keys_10_20, 6);
+  tsds_ck_assert_bt_range(11, 19, keys_10_20 + 1, 4);
+  tsds_ck_assert_bt_range(12, 12, keys_10_20 + 1, 1);
+  tsds_ck_assert_bt_range(13, 13, NULL, 0);
+  tsds_ck_assert_bt_range(20, 10, NULL, 0);
+  tsds_ck_assert_bt_range(INT_MIN, 0, keys_ends, 2);
+  tsds_ck_assert_bt_range(INT_MAX, INT_MAX, keys_max, 1);
+  tsds_ck_assert_bt_range(2 * TSDS_BT_KEYS - 1, INT_MAX, keys_max, 1);
+
+  btkeys.n = 0;
+  btkeys.stop_at = 0;
+  ck_assert_int_eq(bt_range(bt, INT_MIN, INT_MAX, tsds_bt_collect, &btkeys), 0);
+  ck_assert_int_eq(btkeys.n, TSDS_BT_KEYS + 2);
+
+  /* A nonzero callback stops the scan and is returned */
+  btkeys.n = 0;
+  btkeys.stop_at = 3;
+  ck_assert_int_eq(bt_range(bt, 1, INT_MAX, tsds_bt_collect, &btkeys), 1);
+  ck_assert_int_eq(btkeys.n, 3);
+  ck_assert_int_eq(btkeys.keys[0], 2);
+  ck_assert_int_eq(btkeys.keys[2], 6);
+
+  /* Pages of 10 keys, 20 and the already returned 18 are
+     removed after the first one */
+  ck_assert_int_eq(bt_iter_seek(&it, bt, 0, INT_MAX), 0);
+  count = 0;
+  last = -1;
+  do
+  {
+    for (i = 0; i < 10 && (node = bt_iter_next(&it)); i++, count++)
+    {
+      ck_assert_int_gt(node->key, last);
+      ck_assert_int_ne(node->key, 20);
+      last = node->key;
+    }
+    bt_iter_release(&it);
+    if (count == 10)
+    {
+      ck_assert_int_eq(last, 18);
+      ck_assert_int_eq(bt_remove(bt, 20), 0);
+      ck_assert_int_eq(bt_remove(bt, 18), 0);
+    }
+  } while (i == 10 && bt_iter_resume(&it) == 0);
+  ck_assert_int_eq(last, INT_MAX);
+  ck_assert_int_eq(count, TSDS_BT_KEYS);
+
+  /* A finished iteration stays finished */
+  ck_assert_int_eq(bt_iter_resume(&it), 0);
+  ck_assert_ptr_null(bt_iter_next(&it));
+  bt_iter_release(&it);
+}
+
+void *
+tsds_bt_stress(void * arg)
+{
+  tsds_btarg_t * btarg = (tsds_btarg_t *)arg;
+  node_t * node;
+  int i, key, op;
+
+  for (i = 0; i < TSDS_BT_OPS; i++)
+  {
+    key = rand_r(&btarg->seed) % TSDS_BT_KEYS;
+    op = rand_r(&btarg->seed) % 4;
+
+    if (op == 0)
+      insert(btarg->bt, tsds_bt_node(key, i));
+    else if (op == 1)
+      bt_remove(btarg->bt, key);
+    else if ((node = find(btarg->bt, key)))
+    {
+      /* Keep the node while the other threads write */
+      sched_yield();
+      if (!tsds_bt_node_ok(node, key))
+        btarg->bad++;
+    }
+  }
+  return 0;
+}
+
+int
+tsds_bt_scan_node(node_t * node, void * ctx)
+{
+  tsds_btarg_t * btarg = (tsds_btarg_t *)ctx;
+
+  if (node->key <= btarg->last || !tsds_bt_node_ok(node, node->key))
+    btarg->bad++;
+  btarg->last = node->key;
+  return 0;
+}
+
+void *
+tsds_bt_scan(void * arg)
+/* Scans every key in order, alternating whole ranges with
+** pages that release the tree in between.
+**/
+{
+  tsds_btarg_t * btarg = (tsds_btarg_t *)arg;
+  bt_iter_t it;
+  node_t * node;
+  int i, count;
+
+  for (i = 0; i < TSDS_BT_SCANS; i++)
+  {
+    btarg->last = -1;
+    if (i % 2 == 0)
+    {
+      if (bt_range(btarg->bt, 0, TSDS_BT_KEYS, tsds_bt_scan_node, btarg))
+        btarg->bad++;
+      continue;
+    }
+
+    if (bt_iter_seek(&it, btarg->bt, 0, TSDS_BT_KEYS))
+    {
+      btarg->bad++;
+      continue;
+    }
+    do
+    {
+      for (count = 0; count < TSDS_BT_PAGE && (node = bt_iter_next(&it)); count++)
+        tsds_bt_scan_node(node, btarg);
+      bt_iter_release(&it);
+      sched_yield();
+    } while (count == TSDS_BT_PAGE && bt_iter_resume(&it) == 0);
+  }
+  return 0;
+}
+
+void
+tsds_ck_assert_bt_stress(int flags)
+/* Threads insert, replace, remove and find the same few
+** keys while another one scans them in order. Found nodes
+** must stay readable, which the tests' sanitizer build
+** checks, and keep their key and value.
+**/
+{
+  pthread_t threads[TSDS_BT_THREADS + 1];
+  tsds_btarg_t btargs[TSDS_BT_THREADS + 1];
+  node_t * node;
+  int i, key;
+
+  bt_init(&bt, flags);
+
+  for (i = 0; i <= TSDS_BT_THREADS; i++)
+  {
+    btargs[i].bt = bt;
+    btargs[i].seed = i + 1;
+    btargs[i].bad = 0;
+    ck_assert_int_eq(pthread_create(&threads[i], NULL,
+                                    i < TSDS_BT_THREADS ? tsds_bt_stress : tsds_bt_scan,
+                                    &btargs[i]), 0);
+  }
+
+  for (i = 0; i <= TSDS_BT_THREADS; i++)
+  {
+    ck_assert_int_eq(pthread_join(threads[i], NULL), 0);
+    ck_assert_int_eq(btargs[i].bad, 0);
+  }
+
+  for (key = 0; key < TSDS_BT_KEYS; key++)
+    if ((node = find(bt, key)))
+      ck_assert_int_eq(tsds_bt_node_ok(node, key), 1);
+}
+
+/*---------------------------------------*/
+/* Unit Tests                            */
+/*---------------------------------------*/
+START_TEST(test_bt_balanced)
+/* Checks AVL trees against a reference set and that
+** ascending inserts keep them within the AVL height bound.
+**/
+{
+  int i;
+
+  tsds_ck_assert_bt_reference(BT_BALANCED);
+  free_bt(bt);
+  bt = NULL;
+
+  bt_init(&bt, BT_BALANCED);
+  for (i = 0; i < TSDS_BT_OPS; i++)
+  {
+    ck_assert_int_eq(insert(bt, tsds_bt_node(i, 1)), 0);
+    if ((i & (i + 1)) == 0)
+      tsds_ck_assert_bt_avl_height(bt, i + 1);
+  }
+  tsds_ck_assert_bt_avl_height(bt, TSDS_BT_OPS);
+}
+END_TEST
+
+START_TEST(test_bt_bplus)
+/* Checks the B+-tree engine against a reference set.
+**/
+{
+  tsds_ck_assert_bt_reference(BT_BPLUS);
+}
+END_TEST
+
+START_TEST(test_bt_lockfree)
+/* Checks the lock-free engine against a reference set.
+**/
+{
+  tsds_ck_assert_bt_reference(BT_LOCKFREE);
+}
+END_TEST
+
+START_TEST(test_mt_bt_lockfree)
+/* Tests the lock-free engine under concurrent inserts,
+** replaces, removes and finds of the same keys.
+**/
+{
+  tsds_ck_assert_bt_stress(BT_LOCKFREE);
+}
+END_TEST
+
+START_TEST(test_bt_arena)
+/* Checks every engine with arena nodes against a reference
+** set, and that replaced arena nodes are recycled.
+**/
+{
+  int const flags[] = { BT_DEFAULT, BT_BALANCED, BT_BPLUS,
+                        BT_LOCKFREE, BT_FINE_LOCK };
+  size_t i;
+
+  for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+  {
+    tsds_ck_assert_bt_reference(flags[i] | BT_ARENA);
+    free_bt(bt);
+    bt = NULL;
+
+    tsds_ck_assert_bt_replace(flags[i] | BT_ARENA);
+    free_bt(bt);
+    bt = NULL;
+  }
+}
+END_TEST
+
+START_TEST(test_bt_new_node)
+/* Tests that values up to BT_INLINE_VALUE - 1 bytes and
+** just past it live in the node's own allocation, that
+** lengths are kept for values with embedded NULs, and that
+** new_node_take hands its buffer to the node, which frees
+** it once, also after the node was recycled.
+**/
+{
+  char value[BT_INLINE_VALUE + 2];
+  char * taken;
+  node_t * n;
+  size_t len;
+
+  for (len = BT_INLINE_VALUE - 1; len <= BT_INLINE_VALUE + 1; len++)
+  {
+    memset(value, 'a' + len, len);
+    value[len] = '\0';
+    n = new_node(1, value);
+    ck_assert_ptr_nonnull(n);
+    ck_assert_ptr_eq(n->value, n->inline_value);
+    ck_assert_uint_eq(n->value_len, len);
+    ck_assert_uint_ge(n->value_cap, len);
+    ck_assert_str_eq(n->value, value);
+    free_node(n);
+  }
+
+  /* Only len bytes are copied, NULs included */
+  n = new_node_len(2, "ab\0cdefgh", 5);
+  ck_assert_ptr_nonnull(n);
+  ck_assert_uint_eq(n->value_len, 5);
+  ck_assert_int_eq(memcmp(n->value, "ab\0cd", 5), 0);
+  ck_assert_int_eq(n->value[5], '\0');
+  free_node(n);
+
+  n = new_node_len(3, "0123456789abcdefghij", 16);
+  ck_assert_uint_eq(n->value_len, 16);
+  ck_assert_str_eq(n->value, "0123456789abcdef");
+  free_node(n);
+
+  taken = strdup("a value too long to be inlined");
+  n = new_node_take(4, taken, strlen(taken));
+  ck_assert_ptr_nonnull(n);
+  ck_assert_ptr_eq(n->value, taken);
+  ck_assert_uint_eq(n->value_len, strlen(taken));
+  free_node(n);
+
+  /* A recycled node keeps its adopted buffer until free_bt */
+  bt_init(&bt, BT_DEFAULT);
+  taken = strdup("another value too long to be inlined");
+  ck_assert_int_eq(insert(bt, new_node_take(5, taken, strlen(taken))), 0);
+  ck_assert_int_eq(bt_remove(bt, 5), 0);
+  n = bt_new_node(bt, 6, "short");
+  ck_assert_ptr_eq(n->value, taken);
+  ck_assert_str_eq(n->value, "short");
+  ck_assert_int_eq(insert(bt, n), 0);
+}
+END_TEST
+
+START_TEST(test_bt_insert_node)
+/* Tests that insert_node hands back the node it replaced,
+** after moving its children to the new one.
+**/
+{
+  node_t * root = NULL;
+  node_t * old;
+  node_t * n;
+
+  ck_assert_int_eq(insert_node(&root, new_node(2, "2:1"), &old), 0);
+  ck_assert_ptr_null(old);
+  ck_assert_int_eq(insert_node(&root, new_node(1, "1:1"), &old), 0);
+  ck_assert_int_eq(insert_node(&root, new_node(3, "3:1"), &old), 0);
+  ck_assert_ptr_null(old);
+
+  n = new_node(2, "2:2");
+  ck_assert_int_eq(insert_node(&root, n, &old), 0);
+  ck_assert_ptr_eq(root, n);
+  ck_assert_ptr_nonnull(old);
+  ck_assert_str_eq(old->value, "2:1");
+  ck_assert_ptr_null(old->left);
+  ck_assert_ptr_null(old->right);
+  ck_assert_int_eq(root->left->key, 1);
+  ck_assert_int_eq(root->right->key, 3);
+
+  free_node(old);
+  free_subtree(root);
+}
+END_TEST
+
+START_TEST(test_bt_bulk_load)
+/* Tests bt_bulk_load and bt_bulk_load_threads on every
+** engine that builds the tree in one pass.
+**/
+{
+  int const flags[] = { BT_DEFAULT, BT_BALANCED, BT_BPLUS, BT_LOCKFREE };
+  size_t i;
+
+  for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+  {
+    tsds_ck_assert_bt_bulk(flags[i]);
+    free_bt(bt);
+    bt = NULL;
+  }
+}
+END_TEST
+
+START_TEST(test_bt_ordered)
+/* Tests bt_range and the iterator on the engines that
+** share the tree's semaphores.
+**/
+{
+  int const flags[] = { BT_DEFAULT, BT_BALANCED, BT_BPLUS };
+  size_t i;
+
+  for (i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+  {
+    tsds_ck_assert_bt_ordered(flags[i]);
+    free_bt(bt);
+    bt = NULL;
+  }
+}
+END_TEST
+
+START_TEST(test_bt_bplus_emptied)
+/* Tests that a B+-tree emptied by removes, which keeps its
+** inner nodes, still counts as empty for bulk loads.
+**/
+{
+  int keys[TSDS_BT_KEYS];
+  char * values[TSDS_BT_KEYS];
+  int i;
+
+  bt_init(&bt, BT_BPLUS);
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+  {
+    keys[i] = i;
+    values[i] = "v";
+    ck_assert_int_eq(insert(bt, tsds_bt_node(i, 1)), 0);
+  }
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+    ck_assert_int_eq(bt_remove(bt, i), 0);
+  ck_assert_int_eq(bt->bp_root->leaf, 0);
+
+  ck_assert_int_eq(bt_bulk_load(bt, keys, values, TSDS_BT_KEYS), 0);
+  for (i = 0; i < TSDS_BT_KEYS; i++)
+    ck_assert_ptr_nonnull(find(bt, i));
+  ck_assert_int_eq(bt_bulk_load(bt, keys, values, TSDS_BT_KEYS), -1);
+}
+END_TEST
+
+START_TEST(test_bt_fine_lock)
+/* Checks hand-over-hand locking against a reference set.
+**/
+{
+  tsds_ck_assert_bt_reference(BT_FINE_LOCK);
+}
+END_TEST
+
+START_TEST(test_mt_bt_fine_lock)
+/* Tests hand-over-hand inserts, replaces and removes
+** racing finds and ordered scans of the same keys.
+**/
+{
+  tsds_ck_assert_bt_stress(BT_FINE_LOCK);
+}
+END_TEST
+
+Suite *
+bintree_suite(void)
+{
+  Suite * suite;
+  TCase * tc_core;
+
+  suite = suite_create("Binary Tree");
+
+  tc_core = tcase_create("Core");
+  tcase_add_checked_fixture(tc_core, setup, teardown);
+  tcase_set_timeout(tc_core, 0.0); /* Disables timeout */
+
+  /* Single threaded tests */
+  tcase_add_test(tc_core, test_bt_balanced);
+  tcase_add_test(tc_core, test_bt_bplus);
+  tcase_add_test(tc_core, test_bt_lockfree);
+  tcase_add_test(tc_core, test_bt_fine_lock);
+  tcase_add_test(tc_core, test_bt_arena);
+  tcase_add_test(tc_core, test_bt_new_node);
+  tcase_add_test(tc_core, test_bt_insert_node);
+  tcase_add_test(tc_core, test_bt_bulk_load);
+  tcase_add_test(tc_core, test_bt_bplus_emptied);
+  tcase_add_test(tc_core, test_bt_ordered);
+
+  /* Multithreaded tests */
+  tcase_add_test(tc_core, test_mt_bt_lockfree);
+  tcase_add_test(tc_core, test_mt_bt_fine_lock);
+
+  suite_add_tcase(suite, tc_core);
+
+  return suite;
+}
+
+int
+main(void)
+{
+  int num_tests_failed;
+
+  Suite * suite;
+  SRunner *suite_runner;
+
+  suite = bintree_suite();
+  suite_runner = srunner_create(suite);
+
+  srunner_run_all(suite_runner, CK_NORMAL);
+  num_tests_failed = srunner_ntests_failed(suite_runner);
+  srunner_free(suite_runner);
+
+  return (num_tests_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}